@@ -1,24 +1,197 @@
 #pragma once
 
 #include <queue>
-#include <functional>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#include <algorithm>
+#include <cstddef>
+#include <optional>
+#include <vector>
+#include <tuple>
+#include <future>
+#include <thread>
+#include <bit>
+
+#include "Node_Pool.h"
+#include "Tree_Augment.h"
+#include "Stats.h"
 
 namespace myDS {
 
-    template <typename T>
+    // Nodes come from Alloc<Node>, by default a NodePool that recycles the nodes of removed values.
+    // Every node caches its height, its subtree size and the Augment aggregate of its subtree
+    // (see Tree_Augment.h), which gives O(log n) select, rank, countInRange and rangeAggregate.
+    template <typename T, template <typename> class Alloc = NodePool, typename Augment = NoAggregate<T>>
     class AVL {
         struct Node {
             T m_val;
             Node* left{ nullptr };
             Node* right{ nullptr };
+            int m_height{ 0 };
+            std::size_t m_size{ 1 };
+            [[no_unique_address]] typename Augment::value_type m_agg;
 
             Node(T val = T{}, Node* l = nullptr, Node* r = nullptr) :
-                m_val{ val }, left{ l }, right{ r }
+                m_val{ val }, left{ l }, right{ r }, m_agg{ Augment::lift(m_val) }
             { }
         };
 
     public:
+        // Owns a node taken out of the tree by extract(), insert() puts it back without allocating.
+        // A handle must not outlive the tree it came from.
+        class NodeHandle {
+        public:
+            NodeHandle() { }
+
+            NodeHandle(NodeHandle&& other) noexcept :
+                m_node{ std::exchange(other.m_node, nullptr) }, m_alloc{ other.m_alloc }
+            { }
+
+            NodeHandle& operator=(NodeHandle&& other) noexcept {
+                if (this != &other) {
+                    reset();
+                    m_node = std::exchange(other.m_node, nullptr);
+                    m_alloc = other.m_alloc;
+                }
+                return *this;
+            }
+
+            ~NodeHandle() { reset(); }
+
+            bool empty() const noexcept { return !m_node; }
+            explicit operator bool() const noexcept { return m_node; }
+
+            // the value may be changed before the node is inserted again
+            T& value() const noexcept { return m_node->m_val; }
+
+        private:
+            friend class AVL;
+
+            NodeHandle(Node* node, Alloc<Node>* alloc) : m_node{ node }, m_alloc{ alloc } { }
+
+            void reset() noexcept {
+                if (m_node) m_alloc->destroy(m_node);
+                m_node = nullptr;
+            }
+
+            Node* m_node{ nullptr };
+            Alloc<Node>* m_alloc{ nullptr };
+        };
+
+        // In-order iterator over the values, keeps the path from the root to its node, so the tree
+        // needs no parent links. Any change to the tree invalidates its iterators.
+        class const_iterator {
+        public:
+            using iterator_category = std::bidirectional_iterator_tag;
+            using value_type = T;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const T*;
+            using reference = const T&;
+
+            const_iterator() { }
+
+            reference operator*() const noexcept { return m_path.back()->m_val; }
+            pointer operator->() const noexcept { return &m_path.back()->m_val; }
+
+            const_iterator& operator++() {
+                const Node* node{ m_path.back() };
+                if (node->right) {
+                    pushLeftmost(node->right);
+                    return *this;
+                }
+
+                // go up until the path turns right, coming from a left subtree
+                m_path.pop_back();
+                while (!m_path.empty() && m_path.back()->right == node) {
+                    node = m_path.back();
+                    m_path.pop_back();
+                }
+                return *this;
+            }
+
+            const_iterator& operator--() {
+                if (m_path.empty()) {
+                    pushRightmost(m_root);
+                    return *this;
+                }
+
+                const Node* node{ m_path.back() };
+                if (node->left) {
+                    pushRightmost(node->left);
+                    return *this;
+                }
+
+                m_path.pop_back();
+                while (!m_path.empty() && m_path.back()->left == node) {
+                    node = m_path.back();
+                    m_path.pop_back();
+                }
+                return *this;
+            }
+
+            const_iterator operator++(int) {
+                const_iterator it{ *this };
+                ++*this;
+                return it;
+            }
+
+            const_iterator operator--(int) {
+                const_iterator it{ *this };
+                --*this;
+                return it;
+            }
+
+            bool operator==(const const_iterator& other) const noexcept { return current() == other.current(); }
+
+        private:
+            friend class AVL;
+
+            explicit const_iterator(const Node* root) : m_root{ root } { }
+
+            const Node* current() const noexcept { return m_path.empty() ? nullptr : m_path.back(); }
+
+            void pushLeftmost(const Node* node) {
+                for (; node; node = node->left) m_path.push_back(node);
+            }
+
+            void pushRightmost(const Node* node) {
+                for (; node; node = node->right) m_path.push_back(node);
+            }
+
+            const Node* m_root{ nullptr };
+            std::vector<const Node*> m_path; // root first, empty at end()
+        };
+
+        // the values are the keys, they can't be changed in place
+        using iterator = const_iterator;
+
         AVL() { }
+
+        // Builds the tree from the sorted range [first, last) in O(n), repeated values are kept once.
+        template <typename It>
+        AVL(It first, It last) {
+            std::vector<T> values;
+            for (; first != last; ++first) {
+                if (values.empty() || values.back() < *first) values.push_back(*first);
+            }
+            root = build(values, 0, values.size());
+        }
+
+        AVL(const AVL&) = delete;
+        AVL& operator=(const AVL&) = delete;
+
+        // Moving a tree invalidates the handles extracted from it.
+        AVL(AVL&& other) : root{ std::exchange(other.root, nullptr) }, m_alloc{ std::move(other.m_alloc) } { }
+
+        AVL& operator=(AVL&& other) {
+            if (this != &other) {
+                cleanup(root);
+                root = std::exchange(other.root, nullptr);
+                m_alloc = std::move(other.m_alloc);
+            }
+            return *this;
+        }
         
         /*
         * Interface
@@ -28,8 +201,76 @@ namespace myDS {
             return getHeightHelper(root);
         }
 
+        std::size_t size() const noexcept { return augment::size<Node>(root, nullptr); }
+
+        const_iterator begin() const {
+            const_iterator it{ root };
+            it.pushLeftmost(root);
+            return it;
+        }
+
+        const_iterator end() const { return const_iterator{ root }; }
+
+        // first value >= val
+        const_iterator lower_bound(const T& val) const {
+            return bound(val, [](const T& nodeVal, const T& key) { return nodeVal < key; });
+        }
+
+        // first value > val
+        const_iterator upper_bound(const T& val) const {
+            return bound(val, [](const T& nodeVal, const T& key) { return !(key < nodeVal); });
+        }
+
+        // Calls visit(value) for the values in [lo, hi) in increasing order in O(log n + k) for k values.
+        // A visitor that returns bool stops the scan by returning false.
+        template <typename Visitor>
+        void rangeScan(const T& lo, const T& hi, Visitor&& visit) const {
+            augment::rangeScan<Node>(root, nullptr, lo, hi, visit);
+        }
+
+        // k-th smallest value (0-based), nothing if k >= size()
+        std::optional<T> select(std::size_t k) const {
+            const Node* node{ augment::select<Node>(root, nullptr, k) };
+            if (!node) return std::nullopt;
+            return node->m_val;
+        }
+
+        // number of values less than val
+        std::size_t rank(const T& val) const {
+            return augment::rank<Node>(root, nullptr, val);
+        }
+
+        // number of values in [lo, hi)
+        std::size_t countInRange(const T& lo, const T& hi) const {
+            if (!(lo < hi)) return 0;
+            return rank(hi) - rank(lo);
+        }
+
+        // Augment aggregate of the values in [lo, hi)
+        typename Augment::value_type rangeAggregate(const T& lo, const T& hi) const {
+            return augment::rangeAggregate<Augment, Node>(root, nullptr, lo, hi);
+        }
+
         void insert(T val) {
-            root = insertHelper(root, val);
+            bool inserted{ false };
+            root = insertHelper(root, val, nullptr, inserted);
+        }
+
+        // Links the handle's node into the tree. Returns false and leaves the handle as it was if the value
+        // is already in the tree. A handle from another tree is inserted as a copy of its value.
+        bool insert(NodeHandle&& handle) {
+            if (handle.empty()) return false;
+            if (handle.m_alloc != &m_alloc) {
+                bool inserted{ false };
+                root = insertHelper(root, handle.value(), nullptr, inserted);
+                if (inserted) handle.reset();
+                return inserted;
+            }
+
+            bool inserted{ false };
+            root = insertHelper(root, handle.value(), handle.m_node, inserted);
+            if (inserted) handle.m_node = nullptr;
+            return inserted;
         }
 
         bool search(T val) const {
@@ -37,40 +278,125 @@ namespace myDS {
         }
 
         void remove(T val) {
-            root = removeHelper(root, val);
+            Node* detached{ nullptr };
+            root = removeHelper(root, val, detached);
+            if (detached) m_alloc.destroy(detached);
+        }
+
+        // Unlinks the node holding val and returns it, the handle is empty if val isn't in the tree.
+        NodeHandle extract(const T& val) {
+            Node* detached{ nullptr };
+            root = removeHelper(root, val, detached);
+            return NodeHandle(detached, &m_alloc);
         }
 
         ~AVL() { cleanup(root); }
 
+        /*
+        * Join based bulk operations
+        */
+
+        // Appends the values of greater, which must all be greater than the values of this tree, in O(log n).
+        // greater ends up empty.
+        void join(AVL&& greater) {
+            m_alloc.merge(greater.m_alloc);
+            root = join2(root, std::exchange(greater.root, nullptr));
+        }
+
+        // Moves the values >= key to the returned tree in O(log n).
+        AVL split(const T& key) {
+            AVL result{ m_alloc.share() };
+            auto [less, equal, greater] = split3(root, key);
+            root = less;
+            result.root = equal ? join(nullptr, equal, greater) : greater;
+            return result;
+        }
+
+        // Adds the values of other, other ends up empty. The two halves of every recursion step
+        // run in parallel near the top of the trees.
+        void unionWith(AVL&& other) {
+            m_alloc.merge(other.m_alloc);
+            std::vector<Node*> dropped;
+            root = unionHelper(root, std::exchange(other.root, nullptr), 0, dropped);
+            // freed only now, the pool is not shared by the tasks
+            for (Node* node : dropped) m_alloc.destroy(node);
+        }
+
+        // Keeps the values that other contains too.
+        void intersectWith(const AVL& other) {
+            std::vector<Node*> dropped;
+            root = filter(root, [&other](const T& val) { return other.search(val); }, 0, dropped);
+            for (Node* node : dropped) m_alloc.destroy(node);
+        }
+
+        // Removes the values that other contains.
+        void subtract(const AVL& other) {
+            std::vector<Node*> dropped;
+            root = filter(root, [&other](const T& val) { return !other.search(val); }, 0, dropped);
+            for (Node* node : dropped) m_alloc.destroy(node);
+        }
+
         /*
         * DFS and BFS traversals
         */
-        void preorderTraverse(std::function<void(T)> func) const noexcept {
+        template <typename Func>
+        void preorderTraverse(Func func) const noexcept {
             preorderTraverseHelper(root, func);
         }
 
-        void inorderTraverse(std::function<void(T)> func) const noexcept {
+        template <typename Func>
+        void inorderTraverse(Func func) const noexcept {
             inorderTraverseHelper(root, func);
         }
 
-        void postorderTraverse(std::function<void(T)> func) const noexcept {
+        template <typename Func>
+        void postorderTraverse(Func func) const noexcept {
             postorderTraverseHelper(root, func);
         }
 
-        void levelOrderTraverse(std::function<void(T)> func) const noexcept {
+        template <typename Func>
+        void levelOrderTraverse(Func func) const noexcept {
             levelOrderTraverseHelper(root, func);
         }
 
     private:
         Node* root{ nullptr };
+        Alloc<Node> m_alloc;
+
+        static constexpr std::size_t parallelGrain{ 2048 }; // smaller subproblems aren't worth a task
+
+        explicit AVL(Alloc<Node>&& alloc) : m_alloc{ std::move(alloc) } { }
 
 
     private:
 
+        // iterator to the first value for which goesRight(value, val) is false
+        template <typename GoesRight>
+        const_iterator bound(const T& val, GoesRight goesRight) const {
+            const_iterator it{ root };
+            for (const Node* node{ root }; node; node = goesRight(node->m_val, val) ? node->right : node->left) {
+                it.m_path.push_back(node);
+            }
+
+            // the path ends with the nodes passed on the right of the result
+            while (!it.m_path.empty() && goesRight(it.m_path.back()->m_val, val)) it.m_path.pop_back();
+            return it;
+        }
+
         int getHeightHelper(Node* node) const {
             if (!node) return -1;
 
-            return std::max(getHeightHelper(node->left), getHeightHelper(node->right)) + 1;
+            return node->m_height;
+        }
+
+        // recomputes the cached fields of node from its children
+        void update(Node* node) {
+            node->m_height = std::max(getHeightHelper(node->left), getHeightHelper(node->right)) + 1;
+            node->m_size = augment::size<Node>(node->left, nullptr) + augment::size<Node>(node->right, nullptr) + 1;
+            if constexpr (!std::is_empty_v<typename Augment::value_type>) {
+                node->m_agg = Augment::combine(Augment::combine(augment::aggregate<Augment, Node>(node->left, nullptr), Augment::lift(node->m_val)),
+                                               augment::aggregate<Augment, Node>(node->right, nullptr));
+            }
         }
 
         Node* getMin(Node* node) const {
@@ -99,32 +425,48 @@ namespace myDS {
         }
 
         Node* rightRotate(Node* y) {
+            stats::count(stats::rotations);
             Node* x{ y->left };
             
             y->left = x->right;
             x->right = y;
 
+            update(y);
+            update(x);
             return x;
         }
 
         Node* leftRotate(Node* y) {
+            stats::count(stats::rotations);
             Node* x{ y->right };
 
             y->right = x->left;
             x->left = y;
 
+            update(y);
+            update(x);
             return x;
         }
 
-        Node* insertHelper(Node* node, T val) {
-            if (!node) return new Node(val);
+        // fresh is the node to link for val, a new one is created if it's null
+        Node* insertHelper(Node* node, const T& val, Node* fresh, bool& inserted) {
+            if (!node) {
+                inserted = true;
+                if (!fresh) return m_alloc.create(val);
+                update(fresh);
+                return fresh;
+            }
 
             if (val > node->m_val) {
-                node->right = insertHelper(node->right, val);
+                node->right = insertHelper(node->right, val, fresh, inserted);
             }
             else if (val < node->m_val) {
-                node->left = insertHelper(node->left, val);
+                node->left = insertHelper(node->left, val, fresh, inserted);
+            }
+            else {
+                return node;
             }
+            update(node);
 
             int bf{ getBF(node) };
 
@@ -146,34 +488,37 @@ namespace myDS {
             return node;
         }
 
-        Node* removeHelper(Node* node, T val) {
+        // the unlinked node is returned in detached, it still holds val
+        Node* removeHelper(Node* node, const T& val, Node*& detached) {
             if (!node) return nullptr;
 
             if (val < node->m_val) {
-                node->left = removeHelper(node->left, val);
+                node->left = removeHelper(node->left, val, detached);
             }
             else if (val > node->m_val) {
-                node->right = removeHelper(node->right, val);
+                node->right = removeHelper(node->right, val, detached);
             }
             else {
-                if (!node->left) {
-                    Node* tmp = node->right;
-                    delete node;
-                    node = nullptr;
-                    return tmp;
-                }
-                else if (!node->right) {
-                    Node* tmp = node->left;
-                    delete node;
-                    node = nullptr;
+                if (!node->left || !node->right) {
+                    Node* tmp = node->left ? node->left : node->right;
+                    node->left = node->right = nullptr;
+                    detached = node;
                     return tmp;
                 }
 
+                // swap values with the successor and unlink the successor node, which then holds val;
+                // val is smaller than everything in the right subtree, so the search still ends there
                 Node* tmp{ getMin(node->right) };
-                node->m_val = tmp->m_val;
-                node->right = removeHelper(node->right, tmp->m_val);
+                std::swap(node->m_val, tmp->m_val);
+                node->right = removeHelper(node->right, tmp->m_val, detached);
             }
+            update(node);
 
+            return balance(node);
+        }
+
+        // restores the balance of node after one of its subtrees got shorter or taller by more than one level
+        Node* balance(Node* node) {
             int bf{ getBF(node) };
 
             if (bf > 1 && getBF(node->left) >= 0) {
@@ -183,18 +528,156 @@ namespace myDS {
                 node->left = leftRotate(node->left);
                 return rightRotate(node);
             }
-            if (bf < -1 && getBF(node->right) >= 0) {
+            if (bf < -1 && getBF(node->right) > 0) {
                 node->right = rightRotate(node->right);
                 return leftRotate(node);
             }
-            if (bf < -1 && getBF(node->right) < 0) {
+            if (bf < -1 && getBF(node->right) <= 0) {
                 return leftRotate(node);
             }
 
             return node;
         }
 
+        Node* build(const std::vector<T>& values, std::size_t low, std::size_t high) {
+            if (low == high) return nullptr;
+
+            std::size_t mid{ low + (high - low) / 2 };
+            Node* node{ m_alloc.create(values[mid]) };
+            node->left = build(values, low, mid);
+            node->right = build(values, mid + 1, high);
+            update(node);
+            return node;
+        }
+
+        // joins l, k and r where l < k < r, walking down the taller tree to a subtree of the other's height
+        Node* join(Node* l, Node* k, Node* r) {
+            if (getHeightHelper(l) > getHeightHelper(r) + 1) {
+                l->right = join(l->right, k, r);
+                update(l);
+                return balance(l);
+            }
+            if (getHeightHelper(r) > getHeightHelper(l) + 1) {
+                r->left = join(l, k, r->left);
+                update(r);
+                return balance(r);
+            }
+
+            k->left = l;
+            k->right = r;
+            update(k);
+            return k;
+        }
+
+        // unlinks the largest node of t, returns the rest of t and that node
+        std::pair<Node*, Node*> splitLast(Node* t) {
+            if (!t->right) {
+                Node* l{ t->left };
+                t->left = nullptr;
+                update(t);
+                return { l, t };
+            }
+
+            auto [rest, last] = splitLast(t->right);
+            return { join(t->left, t, rest), last };
+        }
+
+        // joins l and r where l < r
+        Node* join2(Node* l, Node* r) {
+            if (!l) return r;
+            if (!r) return l;
+
+            auto [rest, last] = splitLast(l);
+            return join(rest, last, r);
+        }
+
+        // splits t into the values < key, the node holding key if any, and the values > key
+        std::tuple<Node*, Node*, Node*> split3(Node* t, const T& key) {
+            if (!t) return { nullptr, nullptr, nullptr };
+
+            Node* l{ t->left };
+            Node* r{ t->right };
+            if (key < t->m_val) {
+                auto [less, equal, greater] = split3(l, key);
+                return { less, equal, join(greater, t, r) };
+            }
+            if (t->m_val < key) {
+                auto [less, equal, greater] = split3(r, key);
+                return { join(l, t, less), equal, greater };
+            }
+
+            t->left = t->right = nullptr;
+            update(t);
+            return { l, t, r };
+        }
+
+        // runs left on another thread if parallel, right on this one
+        template <typename Left, typename Right>
+        static void forkJoin(bool parallel, Left&& left, Right&& right) {
+            if (!parallel) {
+                left();
+                right();
+                return;
+            }
+
+            auto future{ std::async(std::launch::async, std::forward<Left>(left)) };
+            right();
+            future.get();
+        }
+
+        static bool runParallel(std::size_t depth, std::size_t size) {
+            static const std::size_t maxDepth = std::bit_width(std::max(1u, std::thread::hardware_concurrency()));
+            return depth < maxDepth && size >= parallelGrain;
+        }
+
+        // the nodes of t2 whose value is in t1 too go to dropped
+        Node* unionHelper(Node* t1, Node* t2, std::size_t depth, std::vector<Node*>& dropped) {
+            if (!t1) return t2;
+            if (!t2) return t1;
+
+            bool parallel{ runParallel(depth, t1->m_size + t2->m_size) };
+            Node* l1{ t1->left };
+            Node* r1{ t1->right };
+            auto [l2, equal, r2] = split3(t2, t1->m_val);
+            if (equal) dropped.push_back(equal);
+
+            Node* l{ nullptr };
+            Node* r{ nullptr };
+            std::vector<Node*> leftDropped;
+            std::vector<Node*>& leftOut{ parallel ? leftDropped : dropped };
+            forkJoin(parallel,
+                [&, l1 = l1, l2 = l2] { l = unionHelper(l1, l2, depth + 1, leftOut); },
+                [&, r1 = r1, r2 = r2] { r = unionHelper(r1, r2, depth + 1, dropped); });
+            dropped.insert(dropped.end(), leftDropped.begin(), leftDropped.end());
+
+            return join(l, t1, r);
+        }
+
+        // keeps the nodes of t whose value satisfies pred, the others go to dropped
+        template <typename Pred>
+        Node* filter(Node* t, const Pred& pred, std::size_t depth, std::vector<Node*>& dropped) {
+            if (!t) return nullptr;
+
+            bool parallel{ runParallel(depth, t->m_size) };
+            Node* l{ nullptr };
+            Node* r{ nullptr };
+            std::vector<Node*> leftDropped;
+            std::vector<Node*>& leftOut{ parallel ? leftDropped : dropped };
+            forkJoin(parallel,
+                [&] { l = filter(t->left, pred, depth + 1, leftOut); },
+                [&] { r = filter(t->right, pred, depth + 1, dropped); });
+            dropped.insert(dropped.end(), leftDropped.begin(), leftDropped.end());
+
+            if (pred(t->m_val)) return join(l, t, r);
+
+            t->left = t->right = nullptr;
+            dropped.push_back(t);
+            return join2(l, r);
+        }
+
         void cleanup(Node* node) {
+            // the pool frees all the nodes at once when nothing has to be destroyed one by one
+            if constexpr (Alloc<Node>::releasesInBulk && std::is_trivially_destructible_v<Node>) return;
             if (!node) return;
 
             std::queue<Node*> q;
@@ -207,7 +690,7 @@ namespace myDS {
                 if (tmp->left) q.push(tmp->left);
                 if (tmp->right) q.push(tmp->right);
                 
-                delete tmp;
+                m_alloc.destroy(tmp);
                 tmp = nullptr;
             }
         }
@@ -216,7 +699,8 @@ namespace myDS {
         * DFS and BFS helpers
         */
 
-        void preorderTraverseHelper(Node* node, std::function<void(T)> func) const noexcept {
+        template <typename Func>
+        void preorderTraverseHelper(Node* node, Func& func) const noexcept {
             if (!node) return;
 
             func(node->m_val);
@@ -224,7 +708,8 @@ namespace myDS {
             preorderTraverseHelper(node->right, func);
         }
 
-        void inorderTraverseHelper(Node* node, std::function<void(T)> func) const noexcept {
+        template <typename Func>
+        void inorderTraverseHelper(Node* node, Func& func) const noexcept {
             if (!node) return;
 
             inorderTraverseHelper(node->left, func);
@@ -232,7 +717,8 @@ namespace myDS {
             inorderTraverseHelper(node->right, func);
         }
 
-        void postorderTraverseHelper(Node* node, std::function<void(T)> func) const noexcept {
+        template <typename Func>
+        void postorderTraverseHelper(Node* node, Func& func) const noexcept {
             if (!node) return;
 
             postorderTraverseHelper(node->left, func);
@@ -240,7 +726,8 @@ namespace myDS {
             func(node->m_val);
         }
 
-        void levelOrderTraverseHelper(Node* node, std::function<void(T)> func) const noexcept {
+        template <typename Func>
+        void levelOrderTraverseHelper(Node* node, Func& func) const noexcept {
             if (!node) return;
 
             std::queue<Node*> q;
@@ -252,7 +739,7 @@ namespace myDS {
                     Node* tmp{ q.front() };
                     q.pop();
 
-                    func(node->m_val);
+                    func(tmp->m_val);
 
                     if (tmp->left) q.push(tmp->left);
                     if (tmp->right) q.push(tmp->right);
@@ -22,105 +22,817 @@
 Complexity:
 Preprocessing (Trie and Failure Links): 𝑂(𝑛), where 𝑛 is the sum of the lengths of all patterns.
 Search: 𝑂(𝑚+𝑘), where 𝑚 is the length of the text and 𝑘 is the number of matches found.
+
+Compilation: After the failure links are filled, the pointer Trie is flattened into a DFA.
+* States are numbered in BFS order (the ids from assignIds) and every state gets a precomputed goto row,
+* so scanning is one table load per input byte and failure links are never chased at scan time.
+* Bytes that never occur in a pattern share byte class 0, which keeps the rows narrow.
+
+Scanning: The automaton is built once from the list of words and is not tied to any text.
+* A Scanner holds only the current state and the stream offset, so the text can be fed in chunks
+* (e.g. network buffers) and matches spanning chunk boundaries are still reported.
+* Matches are reported as (pattern id, end offset), where the pattern id is the index of the word in the list
+* and the end offset is the stream position of the last character of the match.
+* Trie nodes carry only the pattern id, the text of every pattern is kept once in a pattern table.
+* All the patterns ending at a state (its own and those reached through output links) are flattened into one
+* contiguous span of pattern ids, so reporting the matches at a position never chases links.
+
+Parallel scanning: The compiled automaton is immutable, so it is shared read-only between worker threads.
+* The text is split into one shard per thread, a worker starts (maxPatternLength - 1) characters before its shard
+* to warm up the state and reports only the matches ending inside its shard, so every match is reported exactly once.
+
+Prefilter: While the automaton is in the root state, only a byte that starts some pattern can leave it.
+* ScanMode::Prefilter uses this to skip ahead in bulk (AVX2 / SSE2 compares against the set of first bytes,
+* a table lookup otherwise) and drops into the automaton only at candidate positions.
+* It pays off for sparse-match workloads with few distinct first bytes, ScanMode::Plain is the reference scan.
+
+Match policies: The policy is a template parameter of the scan, so the unused paths are compiled out of the hot loop.
+* Overlapping reports every match, CountOnly only bumps per-pattern counters, NonOverlapping reports the first match
+* to end and restarts after it, LeftmostFirst / LeftmostLongest report non-overlapping matches with the leftmost start,
+* preferring the pattern registered first / the longest one. The leftmost policies may rescan up to
+* (maxPatternLength - 1) characters after a match, so they work on a whole text rather than on a stream.
+
+Storage: Trie nodes live in one contiguous pool and refer to each other by 32-bit indices instead of pointers.
+* The edges are in the pool too, a node links to its first child and to its next sibling (sorted by char),
+* so building is a sequence of vector appends with no allocation per edge and tearing down releases the whole pool at once.
+
+Serialization: The scan-time tables are reached through a DFA, a non-owning view, so they can live in an
+* Aho_Corasick or in a binary blob written by save(). The blob is position independent (sections are addressed
+* by offsets from its start, in native byte order), so a MappedAutomaton maps the file and scans it in place,
+* with no deserialization, and all the processes mapping the same file share its page-cached copy.
 */
 
+#pragma once
+
 #include <iostream>
 #include <vector>
 #include <queue>
-#include <unordered_map>
 #include <sstream>
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <algorithm>
+#include <bit>
+#include <limits>
+#include <optional>
+#include <fstream>
+#include <cstring>
+#include <type_traits>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "Stats.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 class Aho_Corasick
 {
 public:
+	using NodeIndex = std::uint32_t;
+	static constexpr NodeIndex noNode{ std::numeric_limits<NodeIndex>::max() };
+
 	struct Node
 	{
-		// A map that stores child nodes for each character, representing the Trie structure.
-		std::unordered_map<char, Node*> children;
-		Node* parent{ nullptr };
+		// The children of a node are a list through nextSibling, sorted by their parentChar.
+		NodeIndex firstChild{ noNode };
+		NodeIndex nextSibling{ noNode };
+		NodeIndex parent{ noNode };
 		// Failure link used for backtracking in the Aho-Corasick algorithm.
-		Node* failureLink{ nullptr };
+		NodeIndex failureLink{ noNode };
 		// Output link pointing to the next node with a valid word if the current node is part of multiple patterns.
-		Node* outputLink{ nullptr };
+		NodeIndex outputLink{ noNode };
 		bool isWord{ false };
 		char parentChar{ '*' };
 		int id{ -1 };
-		// The complete pattern (word) associated with this node, if it represents the end of a word.
-		std::string pattern{ };
+		// Index of the word in the list of words, if the node represents the end of a word.
+		int patternId{ -1 };
+	};
+
+	enum class ScanMode
+	{
+		Plain,		// one transition per input byte
+		Prefilter	// skips bytes which can't start a pattern while in the root state
+	};
+
+	// Tags selecting what a scan reports
+	struct MatchPolicy
+	{
+		struct Overlapping { };		// every match, overlapping ones included
+		struct CountOnly { };		// no reports, the sink is a per-pattern counter array indexed by pattern id
+		struct NonOverlapping { };	// the first match to end (the longest one ending there), then restarts after it
+		struct LeftmostFirst { };	// non-overlapping, leftmost start, then the pattern registered first
+		struct LeftmostLongest { };	// non-overlapping, leftmost start, then the longest pattern
+	};
+
+	struct Match
+	{
+		int patternId;
+		std::size_t endOffset;
+	};
+
+	// Non-owning view of the scan-time tables, either of an Aho_Corasick or of a blob written by save().
+	// It is a handful of pointers, cheap to copy, and the viewed storage must outlive it.
+	struct DFA
+	{
+		const std::uint16_t* byteClass;			// maps a byte to its column in the transition table (256 entries)
+		const std::int32_t* transitions;		// numStates x numClasses goto table
+		const std::uint32_t* outputOffsets;		// patterns ending at state s are outputPatterns[outputOffsets[s], outputOffsets[s + 1])
+		const std::int32_t* outputPatterns;
+		const std::uint32_t* stateDepth;		// length of the prefix represented by each state
+		const std::uint8_t* isFirstByte;		// bytes with a transition out of the root (256 entries)
+		const unsigned char* firstBytes;		// the same set as a list, for the SIMD prefilter
+		const std::uint64_t* patternOffsets;	// pattern i is patternChars[patternOffsets[i], patternOffsets[i + 1])
+		const char* patternChars;
+		std::uint32_t numStates;
+		std::uint32_t numClasses;
+		std::uint32_t numPatterns;
+		std::uint32_t numFirstBytes;
+		std::uint32_t numOutputs;				// size of outputPatterns
+		std::size_t maxPatternLength;			// overlap needed between the shards of a parallel scan
+
+		std::string_view getPattern(int patternId) const noexcept
+		{
+			return { patternChars + patternOffsets[patternId], getPatternLength(patternId) };
+		}
+
+		std::size_t getPatternLength(int patternId) const noexcept
+		{
+			return patternOffsets[patternId + 1] - patternOffsets[patternId];
+		}
+
+		// Scans the text with numThreads workers, onMatch(threadIndex, patternId, endOffset) is called concurrently
+		// from the workers, each thread reports the matches of its own shard in offset order.
+		template <ScanMode mode = ScanMode::Plain, typename Callback>
+		void scanParallel(std::string_view text, unsigned numThreads, Callback&& onMatch) const
+		{
+			numThreads = static_cast<unsigned>(std::clamp<std::size_t>(numThreads, 1, std::max<std::size_t>(text.size(), 1)));
+			const std::size_t shardSize{ (text.size() + numThreads - 1) / numThreads };
+			const std::size_t overlap{ maxPatternLength ? maxPatternLength - 1 : 0 };
+
+			auto scanShard = [&](unsigned threadIndex) {
+				const std::size_t begin{ std::min(text.size(), threadIndex * shardSize) };
+				const std::size_t end{ std::min(text.size(), begin + shardSize) };
+				const std::size_t warmUp{ begin > overlap ? begin - overlap : 0 };
 
-		// for Leetcode: 3213. Construct String with Minimum Cost
-		// int len{ -1 };
-		// int cost{ std::numeric_limits<int>::max() };
+				// Matches ending before the shard are reported by the previous shard.
+				Scanner scanner{ *this, warmUp };
+				scanner.feed<mode>(text.substr(warmUp, begin - warmUp), [](int, std::size_t) { });
+				scanner.feed<mode>(text.substr(begin, end - begin), [&](int patternId, std::size_t endOffset) {
+					onMatch(threadIndex, patternId, endOffset);
+				});
+			};
 
+			std::vector<std::thread> workers;
+			for (unsigned t{ 1 }; t < numThreads; ++t) {
+				workers.emplace_back(scanShard, t);
+			}
+			scanShard(0);
+
+			for (std::thread& worker : workers) {
+				worker.join();
+			}
+		}
 
-		friend std::ostream& operator<<(std::ostream& os, const Node* node)
+		// Scans the text with numThreads workers and returns all the matches merged in offset order.
+		template <ScanMode mode = ScanMode::Plain>
+		std::vector<Match> findAllParallel(std::string_view text, unsigned numThreads = std::thread::hardware_concurrency()) const
 		{
-			std::string s{ "[" };
-			for (auto [c, _] : node->children) {
-				s.push_back(c);
-				s.push_back(' ');
+			numThreads = std::max(numThreads, 1u);
+			std::vector<std::vector<Match>> shardMatches(numThreads);
+			scanParallel<mode>(text, numThreads, [&](unsigned threadIndex, int patternId, std::size_t endOffset) {
+				shardMatches[threadIndex].push_back({ patternId, endOffset });
+			});
+
+			// Shards are consecutive, so concatenating them keeps the offset order.
+			std::vector<Match> matches;
+			for (const std::vector<Match>& shard : shardMatches) {
+				matches.insert(matches.end(), shard.begin(), shard.end());
 			}
-			if (s.back() != '[') s.pop_back();
-			s += "]";
 
-			std::string parent = node->parent ? std::to_string(node->parent->id) + "(" + node->parentChar + ")" : "Null";
-			std::string failure = node->failureLink ? std::to_string(node->failureLink->id) : "Null";
-			std::string output = node->outputLink ? " outputLink: " + std::to_string(node->outputLink->id) : "";
+			return matches;
+		}
 
-			os << "Id: " << node->id << " " << s << ", p: " << parent << ", f: " << failure << output;
+		// Returns the first position in [it, end) holding a byte that starts some pattern, or end if there is none.
+		const unsigned char* findCandidate(const unsigned char* it, const unsigned char* end) const noexcept
+		{
+			// Beyond this many first bytes the compares cost more than the table lookup.
+			[[maybe_unused]] constexpr std::size_t maxSimdFirstBytes{ 8 };
 
-			return os;
+	#if defined(__AVX2__)
+			if (numFirstBytes <= maxSimdFirstBytes && end - it >= 32) {
+				__m256i needles[maxSimdFirstBytes];
+				for (std::size_t i{}; i < numFirstBytes; ++i) {
+					needles[i] = _mm256_set1_epi8(static_cast<char>(firstBytes[i]));
+				}
+
+				for (; end - it >= 32; it += 32) {
+					const __m256i block{ _mm256_loadu_si256(reinterpret_cast<const __m256i*>(it)) };
+					__m256i hits{ _mm256_setzero_si256() };
+					for (std::size_t i{}; i < numFirstBytes; ++i) {
+						hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(block, needles[i]));
+					}
+
+					const unsigned mask{ static_cast<unsigned>(_mm256_movemask_epi8(hits)) };
+					if (mask) return it + std::countr_zero(mask);
+				}
+			}
+	#elif defined(__SSE2__)
+			if (numFirstBytes <= maxSimdFirstBytes && end - it >= 16) {
+				__m128i needles[maxSimdFirstBytes];
+				for (std::size_t i{}; i < numFirstBytes; ++i) {
+					needles[i] = _mm_set1_epi8(static_cast<char>(firstBytes[i]));
+				}
+
+				for (; end - it >= 16; it += 16) {
+					const __m128i block{ _mm_loadu_si128(reinterpret_cast<const __m128i*>(it)) };
+					__m128i hits{ _mm_setzero_si128() };
+					for (std::size_t i{}; i < numFirstBytes; ++i) {
+						hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, needles[i]));
+					}
+
+					const unsigned mask{ static_cast<unsigned>(_mm_movemask_epi8(hits)) };
+					if (mask) return it + std::countr_zero(mask);
+				}
+			}
+	#endif
+
+			// Scalar fallback, also handles the tail shorter than a vector
+			while (it != end && !isFirstByte[*it]) ++it;
+			return it;
+		}
+
+		// Scans the whole text with the given policy. The sink is called as sink(patternId, endOffset),
+		// except for CountOnly where it is a counter array and ++sink[patternId] is done per match.
+		template <typename Policy = MatchPolicy::Overlapping, ScanMode mode = ScanMode::Plain, typename Sink>
+		void scan(std::string_view text, Sink&& sink) const
+		{
+			if constexpr (std::is_same_v<Policy, MatchPolicy::LeftmostFirst> || std::is_same_v<Policy, MatchPolicy::LeftmostLongest>) {
+				scanLeftmost<Policy, mode>(text, sink);
+			}
+			else {
+				Scanner scanner{ *this };
+				scanner.feed<mode, Policy>(text, sink);
+			}
+		}
+
+		// Writes the tables into a position independent blob, which can be mapped back with fromBlob.
+		bool save(std::ostream& os) const
+		{
+			BlobHeader header{ makeHeader() };
+			os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+			const std::pair<const void*, std::uint64_t> sections[sectionCount]{
+				{ byteClass, 256 * sizeof(std::uint16_t) },
+				{ transitions, std::uint64_t{ numStates } * numClasses * sizeof(std::int32_t) },
+				{ outputOffsets, (numStates + std::uint64_t{ 1 }) * sizeof(std::uint32_t) },
+				{ outputPatterns, numOutputs * sizeof(std::int32_t) },
+				{ stateDepth, numStates * sizeof(std::uint32_t) },
+				{ isFirstByte, 256 * sizeof(std::uint8_t) },
+				{ firstBytes, numFirstBytes * sizeof(unsigned char) },
+				{ patternOffsets, (numPatterns + std::uint64_t{ 1 }) * sizeof(std::uint64_t) },
+				{ patternChars, patternOffsets[numPatterns] * sizeof(char) }
+			};
+
+			std::uint64_t position{ sizeof(header) };
+			const char padding[blobAlignment]{};
+			for (int i{}; i < sectionCount; ++i) {
+				os.write(padding, header.offsets[i] - position);
+				// the view of an empty table may be a null pointer
+				if (sections[i].second) os.write(static_cast<const char*>(sections[i].first), sections[i].second);
+				position = header.offsets[i] + sections[i].second;
+			}
+			os.write(padding, header.totalSize - position);
+
+			return static_cast<bool>(os);
+		}
+
+		// Views a blob written by save() in place. The blob must be 8-byte aligned (mmap'ed pages are)
+		// and stay alive while the view is used. Returns nullopt if the header, the section bounds or the tables
+		// don't check out: every transition, byte class, output and offset is validated, so a truncated or corrupt
+		// file can't make a later scan read out of bounds. This costs one pass over the tables.
+		static std::optional<DFA> fromBlob(const void* data, std::size_t size) noexcept
+		{
+			if (size < sizeof(BlobHeader) || reinterpret_cast<std::uintptr_t>(data) % alignof(std::uint64_t)) return std::nullopt;
+
+			BlobHeader header;
+			std::memcpy(&header, data, sizeof(header));
+			if (std::memcmp(header.magic, blobMagic, sizeof(blobMagic)) || header.version != blobVersion ||
+				header.byteOrder != blobByteOrder || header.totalSize > size || header.numClasses == 0 || header.numStates == 0 ||
+				header.numClasses > maxClasses || header.numFirstBytes > 256 || header.patternCharsSize > size ||
+				header.maxPatternLength > header.patternCharsSize) {
+				return std::nullopt;
+			}
+
+			// With the counts bounded like this, the section sizes in layOut can't overflow 64 bits.
+
+			// The header must describe exactly the layout save() would have produced for its sizes.
+			BlobHeader expected{ header };
+			expected.layOut();
+			if (std::memcmp(&expected, &header, sizeof(header))) return std::nullopt;
+
+			const char* base{ static_cast<const char*>(data) };
+			DFA dfa{};
+			dfa.byteClass = reinterpret_cast<const std::uint16_t*>(base + header.offsets[0]);
+			dfa.transitions = reinterpret_cast<const std::int32_t*>(base + header.offsets[1]);
+			dfa.outputOffsets = reinterpret_cast<const std::uint32_t*>(base + header.offsets[2]);
+			dfa.outputPatterns = reinterpret_cast<const std::int32_t*>(base + header.offsets[3]);
+			dfa.stateDepth = reinterpret_cast<const std::uint32_t*>(base + header.offsets[4]);
+			dfa.isFirstByte = reinterpret_cast<const std::uint8_t*>(base + header.offsets[5]);
+			dfa.firstBytes = reinterpret_cast<const unsigned char*>(base + header.offsets[6]);
+			dfa.patternOffsets = reinterpret_cast<const std::uint64_t*>(base + header.offsets[7]);
+			dfa.patternChars = base + header.offsets[8];
+			dfa.numStates = header.numStates;
+			dfa.numClasses = header.numClasses;
+			dfa.numPatterns = header.numPatterns;
+			dfa.numFirstBytes = header.numFirstBytes;
+			dfa.numOutputs = header.numOutputs;
+			dfa.maxPatternLength = header.maxPatternLength;
+
+			if (dfa.patternOffsets[header.numPatterns] != header.patternCharsSize || !dfa.tablesAreValid()) return std::nullopt;
+
+			return dfa;
+		}
+
+	private:
+		static constexpr std::uint32_t maxClasses{ 257 };				// class 0 and one class per byte value
+		static constexpr char blobMagic[8]{ 'A', 'C', 'D', 'F', 'A', 'B', 'L', 'B' };
+		static constexpr std::uint32_t blobVersion{ 3 };
+		static constexpr std::uint32_t blobByteOrder{ 0x01020304 };	// reads differently on a host of the other endianness
+		static constexpr std::uint64_t blobAlignment{ 64 };			// every section starts on a cache line
+		static constexpr int sectionCount{ 9 };
+
+		struct BlobHeader
+		{
+			char magic[8];
+			std::uint32_t version;
+			std::uint32_t byteOrder;
+			std::uint32_t numStates;
+			std::uint32_t numClasses;
+			std::uint32_t numPatterns;
+			std::uint32_t numFirstBytes;
+			std::uint32_t numOutputs;
+			std::uint32_t reserved;
+			std::uint64_t maxPatternLength;
+			std::uint64_t patternCharsSize;
+			std::uint64_t offsets[sectionCount];	// from the start of the blob, in the order of the DFA members
+			std::uint64_t totalSize;
+
+			// Computes the offsets and the total size from the counts.
+			void layOut() noexcept
+			{
+				const std::uint64_t sizes[sectionCount]{
+					256 * sizeof(std::uint16_t),
+					std::uint64_t{ numStates } * numClasses * sizeof(std::int32_t),
+					(numStates + std::uint64_t{ 1 }) * sizeof(std::uint32_t),
+					numOutputs * sizeof(std::int32_t),
+					numStates * sizeof(std::uint32_t),
+					256 * sizeof(std::uint8_t),
+					numFirstBytes * sizeof(unsigned char),
+					(numPatterns + std::uint64_t{ 1 }) * sizeof(std::uint64_t),
+					patternCharsSize * sizeof(char)
+				};
+
+				std::uint64_t position{ sizeof(BlobHeader) };
+				for (int i{}; i < sectionCount; ++i) {
+					position = (position + blobAlignment - 1) / blobAlignment * blobAlignment;
+					offsets[i] = position;
+					position += sizes[i];
+				}
+				totalSize = (position + blobAlignment - 1) / blobAlignment * blobAlignment;
+			}
+		};
+
+		// Everything a scan indexes with a value read from the tables stays in bounds.
+		bool tablesAreValid() const noexcept
+		{
+			for (int b{}; b < 256; ++b) {
+				if (byteClass[b] >= numClasses) return false;
+			}
+
+			const std::size_t numTransitions{ static_cast<std::size_t>(numStates) * numClasses };
+			for (std::size_t i{}; i < numTransitions; ++i) {
+				if (transitions[i] < 0 || static_cast<std::uint32_t>(transitions[i]) >= numStates) return false;
+			}
+
+			if (outputOffsets[0] != 0 || outputOffsets[numStates] != numOutputs) return false;
+			for (std::uint32_t s{}; s < numStates; ++s) {
+				if (outputOffsets[s] > outputOffsets[s + 1]) return false;
+			}
+
+			for (std::uint32_t out{}; out < numOutputs; ++out) {
+				if (outputPatterns[out] < 0 || static_cast<std::uint32_t>(outputPatterns[out]) >= numPatterns) return false;
+			}
+
+			if (patternOffsets[0] != 0) return false;
+			for (std::uint32_t i{}; i < numPatterns; ++i) {
+				if (patternOffsets[i] > patternOffsets[i + 1]) return false;
+			}
+
+			return true;
+		}
+
+		template <typename Policy, ScanMode mode, typename Sink>
+		void scanLeftmost(std::string_view text, Sink& sink) const
+		{
+			const unsigned char* data{ reinterpret_cast<const unsigned char*>(text.data()) };
+			const std::size_t n{ text.size() };
+			std::int32_t state{ 0 };
+
+			// the best match found so far, not reported until no match can start at or before its start
+			bool pending{ false };
+			int bestId{ -1 };
+			std::size_t bestStart{}, bestEnd{};
+
+			// reports the pending match, the scan resumes right after it from the root
+			auto commit = [&](std::size_t& pos) {
+				sink(bestId, bestEnd);
+				pending = false;
+				state = 0;
+				pos = bestEnd + 1;
+			};
+
+			for (std::size_t pos{}; ; ) {
+				if constexpr (mode == ScanMode::Prefilter) {
+					if (state == 0) pos = findCandidate(data + pos, data + n) - data;
+				}
+
+				if (pos == n) {
+					if (!pending) break;
+
+					commit(pos);
+					continue;
+				}
+
+				state = transitions[static_cast<std::size_t>(state) * numClasses + byteClass[data[pos]]];
+
+				// The outputs of a state come longest first, i.e. the leftmost start first.
+				for (std::uint32_t out{ outputOffsets[state] }; out != outputOffsets[state + 1]; ++out) {
+					const int id{ outputPatterns[out] };
+					const std::size_t start{ pos + 1 - getPatternLength(id) };
+					bool better{ !pending || start < bestStart };
+					if constexpr (std::is_same_v<Policy, MatchPolicy::LeftmostFirst>) {
+						better = better || (start == bestStart && id < bestId);
+					}
+					else {
+						better = better || (start == bestStart && pos > bestEnd);
+					}
+
+					if (better) {
+						pending = true;
+						bestId = id;
+						bestStart = start;
+						bestEnd = pos;
+					}
+				}
+
+				// A later match starting at or before bestStart would have to extend the current prefix,
+				// which is already shorter than the distance back to bestStart.
+				if (pending && stateDepth[state] < pos + 1 - bestStart) {
+					commit(pos);
+					continue;
+				}
+
+				++pos;
+			}
+		}
+
+		BlobHeader makeHeader() const noexcept
+		{
+			BlobHeader header{};
+			std::memcpy(header.magic, blobMagic, sizeof(blobMagic));
+			header.version = blobVersion;
+			header.byteOrder = blobByteOrder;
+			header.numStates = numStates;
+			header.numClasses = numClasses;
+			header.numPatterns = numPatterns;
+			header.numFirstBytes = numFirstBytes;
+			header.numOutputs = numOutputs;
+			header.maxPatternLength = maxPatternLength;
+			header.patternCharsSize = patternOffsets[numPatterns];
+			header.layOut();
+			return header;
 		}
 	};
 
-	Aho_Corasick(std::string bigText, std::vector<std::string> listOfWords)
-		: text{ std::move(bigText) },
-		  words{ std::move(listOfWords) }
+	// Resumable scanner over a compiled automaton, holds just the current state.
+	// The viewed tables must outlive the scanner and are never modified by it,
+	// so any number of scanners can run over the same automaton.
+	class Scanner
 	{
-		root = new Node{};
+	public:
+		// startOffset is the stream position of the first character that will be fed
+		explicit Scanner(const DFA& automaton, std::size_t startOffset = 0)
+			: dfa{ automaton }, offset{ startOffset }
+		{ }
+
+		// Scans the next chunk of the stream, calling onMatch(patternId, endOffset) for every match ending in it.
+		// For CountOnly onMatch is a counter array, the leftmost policies need the whole text (see DFA::scan).
+		template <ScanMode mode = ScanMode::Plain, typename Policy = MatchPolicy::Overlapping, typename Callback>
+		void feed(std::string_view chunk, Callback&& onMatch)
+		{
+			static_assert(std::is_same_v<Policy, MatchPolicy::Overlapping> || std::is_same_v<Policy, MatchPolicy::CountOnly> ||
+				std::is_same_v<Policy, MatchPolicy::NonOverlapping>, "the leftmost policies can't be streamed, use DFA::scan");
+
+			const std::int32_t* transitions{ dfa.transitions };
+			const std::uint32_t numClasses{ dfa.numClasses };
+			const unsigned char* it{ reinterpret_cast<const unsigned char*>(chunk.data()) };
+			const unsigned char* end{ it + chunk.size() };
+
+			for (; it != end; ++it) {
+				if constexpr (mode == ScanMode::Prefilter) {
+					if (state == 0) {
+						const unsigned char* candidate{ dfa.findCandidate(it, end) };
+						offset += candidate - it;
+						it = candidate;
+						if (it == end) break;
+					}
+				}
+
+				state = transitions[static_cast<std::size_t>(state) * numClasses + dfa.byteClass[*it]];
+
+				if constexpr (std::is_same_v<Policy, MatchPolicy::NonOverlapping>) {
+					// the longest match ending here wins and the next match starts after it
+					if (dfa.outputOffsets[state] != dfa.outputOffsets[state + 1]) {
+						onMatch(dfa.outputPatterns[dfa.outputOffsets[state]], offset);
+						state = 0;
+					}
+				}
+				else {
+					for (std::uint32_t out{ dfa.outputOffsets[state] }; out != dfa.outputOffsets[state + 1]; ++out) {
+						if constexpr (std::is_same_v<Policy, MatchPolicy::CountOnly>) {
+							++onMatch[dfa.outputPatterns[out]];
+						}
+						else {
+							onMatch(dfa.outputPatterns[out], offset);
+						}
+					}
+				}
+
+				++offset;
+			}
+		}
+
+		// Starts a new stream
+		void reset() noexcept
+		{
+			state = 0;
+			offset = 0;
+		}
+
+		std::size_t getOffset() const noexcept { return offset; }
+
+	private:
+		DFA dfa;
+		std::int32_t state{ 0 };
+		std::size_t offset{ 0 };
+	};
+
+	// Read-only mapping of a file written by save(). Scanning runs directly on the mapped pages,
+	// which the OS shares between all the processes mapping the same file.
+	class MappedAutomaton
+	{
+	public:
+		MappedAutomaton() = default;
+		MappedAutomaton(const MappedAutomaton&) = delete;
+		MappedAutomaton& operator=(const MappedAutomaton&) = delete;
+
+		MappedAutomaton(MappedAutomaton&& other) noexcept { *this = std::move(other); }
+
+		MappedAutomaton& operator=(MappedAutomaton&& other) noexcept
+		{
+			if (this != &other) {
+				close();
+				std::swap(data, other.data);
+				std::swap(size, other.size);
+				std::swap(view, other.view);
+#if !defined(__unix__) && !defined(__APPLE__)
+				std::swap(buffer, other.buffer);
+#endif
+			}
+			return *this;
+		}
+
+		~MappedAutomaton() { close(); }
+
+		// Maps the file, returns false if it can't be mapped or doesn't hold a valid automaton.
+		bool open(const std::string& path)
+		{
+			close();
+
+#if defined(__unix__) || defined(__APPLE__)
+			int fd{ ::open(path.c_str(), O_RDONLY) };
+			if (fd < 0) return false;
+
+			struct stat info{};
+			if (::fstat(fd, &info) != 0 || info.st_size <= 0) {
+				::close(fd);
+				return false;
+			}
+
+			size = static_cast<std::size_t>(info.st_size);
+			void* mapping{ ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0) };
+			// the mapping stays valid after the descriptor is closed
+			::close(fd);
+			if (mapping == MAP_FAILED) {
+				size = 0;
+				return false;
+			}
+			data = mapping;
+#else
+			// No mmap here, so the file is read into an 8-byte aligned buffer instead.
+			std::ifstream file{ path, std::ios::binary | std::ios::ate };
+			if (!file) return false;
+
+			size = static_cast<std::size_t>(file.tellg());
+			buffer.resize((size + sizeof(std::uint64_t) - 1) / sizeof(std::uint64_t));
+			file.seekg(0);
+			if (!file.read(reinterpret_cast<char*>(buffer.data()), size)) {
+				close();
+				return false;
+			}
+			data = buffer.data();
+#endif
+
+			view = DFA::fromBlob(data, size);
+			if (!view) close();
+
+			return view.has_value();
+		}
+
+		void close() noexcept
+		{
+#if defined(__unix__) || defined(__APPLE__)
+			if (data) ::munmap(const_cast<void*>(data), size);
+#else
+			buffer.clear();
+#endif
+			data = nullptr;
+			size = 0;
+			view.reset();
+		}
+
+		bool isOpen() const noexcept { return view.has_value(); }
+
+		// Valid only while the automaton is open
+		const DFA& dfa() const noexcept { return *view; }
+
+		Scanner scanner() const { return Scanner{ *view }; }
+
+	private:
+		const void* data{ nullptr };
+		std::size_t size{ 0 };
+		std::optional<DFA> view;
+#if !defined(__unix__) && !defined(__APPLE__)
+		std::vector<std::uint64_t> buffer;
+#endif
+	};
+
+	explicit Aho_Corasick(std::vector<std::string> listOfWords)
+	{
+		// Pattern table, every word is stored exactly once
+		patternOffsets.assign(1, 0);
+		for (const std::string& word : listOfWords) {
+			patternChars += word;
+			patternOffsets.push_back(patternChars.size());
+		}
+
 		buildTrieTree();
 		fillFailureLinks();
+		compile();
+	}
+
+	Aho_Corasick(const Aho_Corasick&) = delete;
+	Aho_Corasick& operator=(const Aho_Corasick&) = delete;
+	Aho_Corasick(Aho_Corasick&&) = default;
+	Aho_Corasick& operator=(Aho_Corasick&&) = default;
+
+	// View of the scan-time tables, invalidated by moving the automaton.
+	DFA dfa() const noexcept
+	{
+		DFA view{};
+		view.byteClass = byteClass.data();
+		view.transitions = transitions.data();
+		view.outputOffsets = outputOffsets.data();
+		view.outputPatterns = outputPatterns.data();
+		view.stateDepth = stateDepth.data();
+		view.isFirstByte = isFirstByte.data();
+		view.firstBytes = firstBytes.data();
+		view.patternOffsets = patternOffsets.data();
+		view.patternChars = patternChars.data();
+		view.numStates = static_cast<std::uint32_t>(outputOffsets.size() - 1);
+		view.numClasses = static_cast<std::uint32_t>(numClasses);
+		view.numPatterns = static_cast<std::uint32_t>(getNumPatterns());
+		view.numFirstBytes = static_cast<std::uint32_t>(firstBytes.size());
+		view.numOutputs = static_cast<std::uint32_t>(outputPatterns.size());
+		view.maxPatternLength = maxPatternLength;
+		return view;
 	}
 
-	~Aho_Corasick()
+	Scanner scanner() const { return Scanner{ dfa() }; }
+
+	std::string_view getPattern(int patternId) const noexcept
+	{
+		return std::string_view{ patternChars }.substr(patternOffsets[patternId], patternOffsets[patternId + 1] - patternOffsets[patternId]);
+	}
+
+	std::size_t getNumPatterns() const noexcept { return patternOffsets.size() - 1; }
+
+	std::size_t getMaxPatternLength() const noexcept { return maxPatternLength; }
+
+	template <ScanMode mode = ScanMode::Plain, typename Callback>
+	void scanParallel(std::string_view text, unsigned numThreads, Callback&& onMatch) const
+	{
+		dfa().scanParallel<mode>(text, numThreads, std::forward<Callback>(onMatch));
+	}
+
+	template <ScanMode mode = ScanMode::Plain>
+	std::vector<Match> findAllParallel(std::string_view text, unsigned numThreads = std::thread::hardware_concurrency()) const
+	{
+		return dfa().findAllParallel<mode>(text, numThreads);
+	}
+
+	template <typename Policy = MatchPolicy::Overlapping, ScanMode mode = ScanMode::Plain, typename Sink>
+	void scan(std::string_view text, Sink&& sink) const
+	{
+		dfa().scan<Policy, mode>(text, sink);
+	}
+
+	// Occurrences of every pattern in the text, indexed by pattern id
+	template <ScanMode mode = ScanMode::Plain>
+	std::vector<std::uint64_t> countPatterns(std::string_view text) const
 	{
-		clear();
+		std::vector<std::uint64_t> counts(getNumPatterns());
+		scan<MatchPolicy::CountOnly, mode>(text, counts);
+		return counts;
+	}
+
+	bool save(std::ostream& os) const { return dfa().save(os); }
+
+	bool save(const std::string& path) const
+	{
+		std::ofstream file{ path, std::ios::binary };
+		return file && save(file) && file.flush();
 	}
 
 	void buildTrieTree()
 	{
-		for (const std::string& word : words) {
-			insert(word);
+		// The total length of the words bounds the node count, so the pool is allocated once.
+		nodes.clear();
+		nodes.reserve(patternChars.size() + 1);
+		nodes.emplace_back(); // root
+
+		for (std::size_t i{}; i < getNumPatterns(); ++i) {
+			// An empty word would turn the root into a match at every position
+			if (!getPattern(static_cast<int>(i)).empty()) insert(getPattern(static_cast<int>(i)), static_cast<int>(i));
 		}
 
 		// Additional function to assign unique id to each node by level for debugging
 		assignIds();
 	}
 
-	void insert(const std::string& s)
+	void insert(std::string_view s, int patternId)
 	{
-		Node* node{ root };
+		NodeIndex node{ root };
 		for (char c : s) {
-			if (!node->children.contains(c)) {
-				node->children[c] = new Node{};
+			NodeIndex next{ findChild(node, c) };
+			if (next != noNode) {
+				node = next;
+				continue;
 			}
 
-			node->children[c]->parent = node;
-			node->children[c]->parentChar = c;
-			node = node->children[c];
-		}
-
-		node->isWord = true;
-		node->pattern = s;
+			// Appending may reallocate the pool, so nodes are only addressed by index here.
+			NodeIndex child{ static_cast<NodeIndex>(nodes.size()) };
+			nodes.emplace_back();
+			nodes[child].parent = node;
+			nodes[child].parentChar = c;
 
+			NodeIndex* link{ &nodes[node].firstChild };
+			while (*link != noNode && charLess(nodes[*link].parentChar, c)) link = &nodes[*link].nextSibling;
+			nodes[child].nextSibling = *link;
+			*link = child;
+			node = child;
+		}
 
-		// node->len = s.size();
-		// node->cost = std::min(node->cost, c);
+		// For duplicate words the first occurrence keeps the id.
+		if (!nodes[node].isWord) nodes[node].patternId = patternId;
+		nodes[node].isWord = true;
 	}
 
 	void assignIds()
 	{
-		std::queue<Node*> q;
+		std::queue<NodeIndex> q;
 		q.push(root);
 		int id{};
 
@@ -128,144 +840,178 @@ public:
 			auto size = q.size();
 
 			while (size--) {
-				Node* node{ q.front() };
+				Node& node{ nodes[q.front()] };
 				q.pop();
 
-				node->id = id++;
+				node.id = id++;
 
-				for (auto [c, nextNode] : node->children) {
-					q.push(nextNode);
+				for (NodeIndex child{ node.firstChild }; child != noNode; child = nodes[child].nextSibling) {
+					q.push(child);
 				}
 			}
 		}
 	}
 
-	void connectFailureLink(Node* node)
+	void connectFailureLink(NodeIndex index)
 	{
+		Node& node{ nodes[index] };
 		// If the node has no parent (i.e., it's the root), do nothing and return.
-		if (!node->parent) return;
+		if (node.parent == noNode) return;
 		// By default, set the failure link to the root (this applies when no proper suffix is found).
-		node->failureLink = root;
+		node.failureLink = root;
 		// If the node's parent is the root, there is no need to find a more specific failure link.
-		if (node->parent == root) return;
+		if (node.parent == root) return;
 
 		// Start with the failure link of the node's parent.
-		Node* failureLink{ node->parent->failureLink };
+		NodeIndex failureLink{ nodes[node.parent].failureLink };
 		
 		// Traverse up the failure links to find the longest suffix match for the current node's parentChar.
-		while (failureLink) {
+		while (failureLink != noNode) {
 			// Check if the current failure link has a child that matches the parentChar of the node.
-			if (failureLink->children.contains(node->parentChar)) {
+			NodeIndex match{ findChild(failureLink, node.parentChar) };
+			if (match != noNode) {
 				// Set the failure link of the node to the matching child node.
-				node->failureLink = failureLink->children[node->parentChar];
+				node.failureLink = match;
 
 				// If the failure link node represents a word, set it as the output link for the current node.
-				if (node->failureLink->isWord == true) {
-					node->outputLink = node->failureLink;
+				if (nodes[node.failureLink].isWord == true) {
+					node.outputLink = node.failureLink;
 				}
 				// Otherwise, inherit the output link from the failure link node.
 				else {
-					node->outputLink = node->failureLink->outputLink;
+					node.outputLink = nodes[node.failureLink].outputLink;
 				}
 
 				break;
 			}
 
 			// Move to the next failure link in the chain.
-			failureLink = failureLink->failureLink;
+			failureLink = nodes[failureLink].failureLink;
+			myDS::stats::count(myDS::stats::failureLinkHops);
 		}
 	}
 
 	// This function initializes failure links for all nodes in the Trie using a BFS.
 	void fillFailureLinks()
 	{
-		std::queue<Node*> q;
+		std::queue<NodeIndex> q;
 		q.push(root);
 
 		while (!q.empty()) {
 			auto size = q.size();
 
 			while (size--) {
-				Node* node{ q.front() };
+				NodeIndex node{ q.front() };
 				q.pop();
 
 				connectFailureLink(node);
 
-				for (auto [c, nextNode] : node->children) {
-					q.push(nextNode);
+				for (NodeIndex child{ nodes[node].firstChild }; child != noNode; child = nodes[child].nextSibling) {
+					q.push(child);
 				}
 			}
 		}
 	}
 
-	void findPatterns() // change the name
+	// Flattens the Trie into the scan-time DFA.
+	// Must be called after fillFailureLinks, as the goto rows of a state are derived from its failure link.
+	void compile()
 	{
-		Node* node{ root };
-
-		// Iterate over each character in the input text.
-		for (int i{}; i < text.size(); ++i) {
-			// Check if the current character exists as a child of the current node.
-			if (node->children.contains(text[i])) {
-				node = node->children[text[i]];
-			}
-			else {
-				// If the character is not a child, follow failure links until a match is found or root is reached.
-				while (node->failureLink && !node->children.contains(text[i])) {
-					node = node->failureLink;
-				}
-				// If no match is found even after following failure links, continue with the next character.
-				if (!node->children.contains(text[i])) {
-					continue;
-				}
-				else {
-					// If a match is found, move to the corresponding child node.
-					node = node->children[text[i]];
+		// Every byte that occurs in a pattern gets its own class, all the others share class 0.
+		byteClass.fill(0);
+		numClasses = 1;
+		maxPatternLength = 0;
+		for (std::size_t i{}; i < getNumPatterns(); ++i) {
+			std::string_view word{ getPattern(static_cast<int>(i)) };
+			maxPatternLength = std::max(maxPatternLength, word.size());
+			for (char c : word) {
+				unsigned char b = static_cast<unsigned char>(c);
+				if (byteClass[b] == 0) {
+					byteClass[b] = static_cast<std::uint16_t>(numClasses++);
 				}
 			}
+		}
 
-			// Temporary pointer to traverse through the current node's output links.
-			Node* curr{ node };
-			// If the current node represents a word, output the word's pattern.
-			if (node->isWord) {
-				std::cout << "Found word: " << node->pattern << std::endl;
-				/*
-				int index = i - node->len + 1;
-				if (dp[index] != std::numeric_limits<int>::max()) {
-					dp[i + 1] = std::min(dp[i + 1], dp[index] + node->cost);
-				}
-				*/
+		// Order the nodes by their BFS id.
+		std::vector<NodeIndex> byId(nodes.size());
+		for (NodeIndex i{}; i < nodes.size(); ++i) byId[nodes[i].id] = i;
+
+		// States are int32 in the table and its rows are addressed with size_t, both must hold the whole table.
+		if (nodes.size() > static_cast<std::size_t>(std::numeric_limits<std::int32_t>::max()) ||
+			nodes.size() > std::numeric_limits<std::size_t>::max() / numClasses) {
+			throw std::length_error{ "Aho_Corasick: too many states for the transition table" };
+		}
+
+		transitions.assign(nodes.size() * numClasses, 0);
+		outputOffsets.assign(nodes.size() + 1, 0);
+		outputPatterns.clear();
+		stateDepth.assign(nodes.size(), 0);
+
+		for (NodeIndex index : byId) {
+			const Node& node{ nodes[index] };
+			std::int32_t* row{ &transitions[static_cast<std::size_t>(node.id) * numClasses] };
+
+			// Class 0 never matches a child, so row[0] always stays at the root.
+			// Missing children take the row of the failure link, which is on a lower level and already filled.
+			if (index != root) {
+				const std::int32_t* failureRow{ &transitions[static_cast<std::size_t>(nodes[node.failureLink].id) * numClasses] };
+				std::copy(failureRow + 1, failureRow + numClasses, row + 1);
+			}
+			for (NodeIndex child{ node.firstChild }; child != noNode; child = nodes[child].nextSibling) {
+				row[byteClass[static_cast<unsigned char>(nodes[child].parentChar)]] = nodes[child].id;
 			}
-			// Traverse the output links to find additional patterns that end at the current position.
-			while (curr->outputLink) {
-				std::cout << "Found word using output link: " << curr->outputLink->pattern << std::endl;
-				/*
-				int index = i - curr->outputLink->len + 1;
-				if (dp[index] != std::numeric_limits<int>::max()) {
-					dp[i + 1] = std::min(dp[i + 1], dp[index] + curr->outputLink->cost);
+
+			// The outputs of a state are its own word followed by the outputs of its output link,
+			// which has a smaller id, so its span is already in place and is copied.
+			// BFS ids are visited in increasing order, so the spans are laid out in state order.
+			if (node.isWord) outputPatterns.push_back(node.patternId);
+			if (node.outputLink != noNode) {
+				const std::int32_t link{ nodes[node.outputLink].id };
+				for (std::uint32_t out{ outputOffsets[link] }; out != outputOffsets[link + 1]; ++out) {
+					outputPatterns.push_back(outputPatterns[out]);
 				}
-				*/
-				
-				curr = curr->outputLink;
 			}
+			outputOffsets[node.id + 1] = static_cast<std::uint32_t>(outputPatterns.size());
+
+			if (index != root) stateDepth[node.id] = stateDepth[nodes[node.parent].id] + 1;
 		}
+
+		// The bytes leaving the root are exactly the first bytes of the patterns.
+		isFirstByte.fill(0);
+		firstBytes.clear();
+		for (NodeIndex child{ nodes[root].firstChild }; child != noNode; child = nodes[child].nextSibling) {
+			const unsigned char c{ static_cast<unsigned char>(nodes[child].parentChar) };
+			isFirstByte[c] = 1;
+			firstBytes.push_back(c);
+		}
+	}
+
+	// Scans the whole text at once and prints the found words.
+	void findPatterns(std::string_view text) const
+	{
+		Scanner scanner{ dfa() };
+		scanner.feed(text, [this](int patternId, std::size_t endOffset) {
+			std::cout << "Found word: " << getPattern(patternId) << " at " << endOffset << std::endl;
+		});
 	}
 
 	void print()
 	{
-		std::queue<Node*> q;
+		std::queue<NodeIndex> q;
 		q.push(root);
 
 		while (!q.empty()) {
 			auto size = q.size();
 
 			while (size--) {
-				Node* node{ q.front() };
+				NodeIndex node{ q.front() };
 				q.pop();
 
-				std::cout << node << "\t";
+				printNode(node);
+				std::cout << "\t";
 
-				for (auto [c, nextNode] : node->children) {
-					q.push(nextNode);
+				for (NodeIndex child{ nodes[node].firstChild }; child != noNode; child = nodes[child].nextSibling) {
+					q.push(child);
 				}
 			}
 
@@ -274,27 +1020,53 @@ public:
 	}
 
 private:
-	void clear()
+	// Chars are ordered as unsigned, like std::string compares them.
+	static bool charLess(char a, char b) noexcept
 	{
-		std::queue<Node*> q;
-		q.push(root);
-
-		while (!q.empty()) {
-			Node* node{ q.front() };
-			q.pop();
+		return static_cast<unsigned char>(a) < static_cast<unsigned char>(b);
+	}
 
-			for (auto [c, nextNode] : node->children) {
-				q.push(nextNode);
-			}
+	// The child of node for c, noNode if there is none.
+	NodeIndex findChild(NodeIndex node, char c) const noexcept
+	{
+		NodeIndex child{ nodes[node].firstChild };
+		while (child != noNode && charLess(nodes[child].parentChar, c)) child = nodes[child].nextSibling;
+		return (child != noNode && nodes[child].parentChar == c) ? child : noNode;
+	}
 
-			node->failureLink = node->outputLink = node->parent = nullptr;
-			delete node;
-			node = nullptr;
+	void printNode(NodeIndex index) const
+	{
+		const Node& node{ nodes[index] };
+		std::string s{ "[" };
+		for (NodeIndex child{ node.firstChild }; child != noNode; child = nodes[child].nextSibling) {
+			s.push_back(nodes[child].parentChar);
+			s.push_back(' ');
 		}
+		if (s.back() != '[') s.pop_back();
+		s += "]";
+
+		std::string parent = node.parent != noNode ? std::to_string(nodes[node.parent].id) + "(" + node.parentChar + ")" : "Null";
+		std::string failure = node.failureLink != noNode ? std::to_string(nodes[node.failureLink].id) : "Null";
+		std::string output = node.outputLink != noNode ? " outputLink: " + std::to_string(nodes[node.outputLink].id) : "";
+
+		std::cout << "Id: " << node.id << " " << s << ", p: " << parent << ", f: " << failure << output;
 	}
 
 private:
-	std::string text;
-	std::vector<std::string> words;
-	Node* root{};
+	static constexpr NodeIndex root{ 0 };
+
+	std::vector<Node> nodes;					// node pool of the build-time Trie, nodes[root] is the root
+
+	// Scan-time DFA built by compile()
+	std::array<std::uint16_t, 256> byteClass{};	// maps a byte to its column in the transition table
+	int numClasses{};							// width of a transition row
+	std::vector<std::int32_t> transitions;		// number of states x numClasses goto table
+	std::vector<std::uint32_t> outputOffsets;	// span of outputPatterns ending at each state, one extra at the end
+	std::vector<std::int32_t> outputPatterns;	// all the pattern ids ending at each state, grouped by state
+	std::vector<std::uint32_t> stateDepth;		// length of the prefix represented by each state
+	std::size_t maxPatternLength{};				// overlap needed between the shards of a parallel scan
+	std::array<std::uint8_t, 256> isFirstByte{};	// bytes with a transition out of the root
+	std::vector<unsigned char> firstBytes;		// the same set as a list, for the SIMD prefilter
+	std::vector<std::uint64_t> patternOffsets;	// pattern i is patternChars[patternOffsets[i], patternOffsets[i + 1])
+	std::string patternChars;
 };
@@ -0,0 +1,910 @@
+#pragma once
+
+#include <iostream>
+#include <array>
+#include <memory>
+#include <vector>
+#include <queue>
+#include <utility>
+#include <iterator>
+#include <algorithm>
+#include <type_traits>
+#include <cstddef>
+
+#include "Stats.h"
+
+// B+ tree map. The values live in the leaves only, the inner nodes hold separator keys,
+// and the leaves are chained in key order, so a range scan is one descent and then a walk
+// over consecutive leaf arrays. Every node but the root has MinDegree - 1 to 2 * MinDegree - 1 keys.
+// K and V must be default constructible, the node arrays are allocated full size.
+template <typename K, typename V, int MinDegree = 32>
+class BPlusTree {
+    static_assert(MinDegree >= 2, "a B+ tree node splits into two nodes of at least one key");
+
+public:
+    static constexpr int m_t = MinDegree; // min degree
+    static constexpr int maxKeys = 2 * MinDegree - 1;
+
+private:
+    struct Node {
+        explicit Node(bool isLeaf) : m_isLeaf{isLeaf} { }
+
+        int m_size{0}; // current number of keys
+        bool m_isLeaf;
+    };
+
+    // frees a node as the type it was created with, so the nodes need no virtual destructor
+    struct NodeDeleter {
+        void operator()(Node* node) const noexcept;
+    };
+
+    using NodePtr = std::unique_ptr<Node, NodeDeleter>;
+
+    // m_keys[i] is greater than the keys under m_children[i] and at most the smallest key under m_children[i + 1]
+    struct InnerNode : Node {
+        InnerNode() : Node{false} { }
+
+        std::array<K, maxKeys> m_keys{};
+        std::array<NodePtr, maxKeys + 1> m_children;
+    };
+
+    struct LeafNode : Node {
+        LeafNode() : Node{true} { }
+
+        std::array<K, maxKeys> m_keys{};
+        std::array<V, maxKeys> m_values{};
+        LeafNode* m_prev{nullptr};
+        LeafNode* m_next{nullptr};
+    };
+
+    // result of an insert into a subtree: the new right sibling of its root and the key that separates them
+    struct Split {
+        K key{};
+        NodePtr right;
+    };
+
+public:
+    // Walks the chained leaves in key order. Any change to the tree invalidates its iterators.
+    class const_iterator {
+        public:
+            using iterator_category = std::bidirectional_iterator_tag;
+            using value_type = std::pair<K, V>;
+            using difference_type = std::ptrdiff_t;
+            using reference = std::pair<const K&, const V&>;
+            using pointer = void;
+
+            const_iterator() { }
+
+            const K& key() const noexcept { return m_leaf->m_keys[m_index]; }
+            const V& value() const noexcept { return m_leaf->m_values[m_index]; }
+            reference operator*() const noexcept { return {key(), value()}; }
+
+            const_iterator& operator++() noexcept;
+            const_iterator& operator--() noexcept;
+
+            const_iterator operator++(int) noexcept { const_iterator it{*this}; ++*this; return it; }
+            const_iterator operator--(int) noexcept { const_iterator it{*this}; --*this; return it; }
+
+            bool operator==(const const_iterator& other) const noexcept {
+                return m_leaf == other.m_leaf && m_index == other.m_index;
+            }
+
+        private:
+            friend class BPlusTree;
+
+            const_iterator(const BPlusTree* tree, const LeafNode* leaf, int index)
+                : m_tree{tree}, m_leaf{leaf}, m_index{index}
+            { }
+
+            const BPlusTree* m_tree{nullptr};
+            const LeafNode* m_leaf{nullptr}; // nullptr at end()
+            int m_index{0};
+    };
+
+    // the values are changed through find() or insert()
+    using iterator = const_iterator;
+
+public:
+    BPlusTree() { }
+
+    BPlusTree(const BPlusTree&) = delete;
+    BPlusTree& operator=(const BPlusTree&) = delete;
+
+    BPlusTree(BPlusTree&& other) noexcept
+        : m_root{std::move(other.m_root)}, m_count{std::exchange(other.m_count, 0)}
+    { }
+
+    BPlusTree& operator=(BPlusTree&& other) noexcept;
+
+    // Inserts key with value, or overwrites the value of key if it is already present.
+    // Returns true if the key is new.
+    bool insert(const K& key, const V& value);
+
+    // Returns false if the key is not present.
+    bool erase(const K& key);
+
+    // the value of key, nullptr if there is none
+    V* find(const K& key);
+    const V* find(const K& key) const;
+
+    bool contains(const K& key) const { return find(key) != nullptr; }
+
+    std::size_t size() const noexcept { return m_count; }
+    bool empty() const noexcept { return m_count == 0; }
+
+    void clear() noexcept;
+
+    const_iterator begin() const;
+    const_iterator end() const { return {this, nullptr, 0}; }
+
+    // first entry with a key >= key
+    const_iterator lower_bound(const K& key) const;
+
+    // first entry with a key > key
+    const_iterator upper_bound(const K& key) const;
+
+    // Calls visit(key, value) for the keys in [lo, hi) in increasing order, walking the leaf chain.
+    // A visitor that returns bool stops the scan by returning false.
+    template <typename Visitor>
+    void rangeScan(const K& lo, const K& hi, Visitor&& visit) const;
+
+    // Replaces the contents with the (key, value) pairs of [first, last), which must be sorted by key,
+    // of a repeated key the last value is kept. The tree is built bottom-up in O(n): leaves are filled
+    // to fillFactor of their capacity, then every level of inner nodes above them the same way.
+    // A fill factor below 1 leaves room for later inserts without splits, it is clamped so that
+    // the nodes stay at least half full.
+    template <typename It>
+    void bulkLoad(It first, It last, double fillFactor = 1.0);
+
+    int getHeight() const noexcept;
+
+    void print() const;
+
+private:
+    // index of the first key >= key in keys[0, size), a branchless binary search
+    static int lowerIndex(const K* keys, int size, const K& key);
+
+    // index of the first key > key in keys[0, size)
+    static int upperIndex(const K* keys, int size, const K& key);
+
+    // the leaf whose key range holds key
+    const LeafNode* findLeaf(const K& key) const;
+
+    Split insertHelper(Node* node, const K& key, const V& value, bool& inserted);
+
+    static void insertIntoLeaf(LeafNode* leaf, int index, const K& key, const V& value);
+
+    // puts key at m_keys[index] and child right of it
+    static void insertIntoInner(InnerNode* node, int index, const K& key, NodePtr child);
+
+    bool eraseHelper(Node* node, const K& key);
+
+    // gives the child m_children[index], which has less than t - 1 keys, a key from a sibling
+    // or merges it with one
+    static void fill(InnerNode* parent, int index);
+    static void borrowFromPrev(InnerNode* parent, int index);
+    static void borrowFromNext(InnerNode* parent, int index);
+
+    // merges the [index + 1]-th child into the [index]-th child
+    static void merge(InnerNode* parent, int index);
+
+    // makes the last node of a bulk loaded level at least half full by taking entries from the one before
+    static void balanceLastLeaves(std::vector<NodePtr>& level, std::vector<K>& minKeys);
+    static void balanceLastInners(std::vector<NodePtr>& level, std::vector<K>& minKeys);
+
+    static LeafNode* asLeaf(Node* node) noexcept { return static_cast<LeafNode*>(node); }
+    static const LeafNode* asLeaf(const Node* node) noexcept { return static_cast<const LeafNode*>(node); }
+    static InnerNode* asInner(Node* node) noexcept { return static_cast<InnerNode*>(node); }
+    static const InnerNode* asInner(const Node* node) noexcept { return static_cast<const InnerNode*>(node); }
+
+private:
+    NodePtr m_root;
+    std::size_t m_count{0};
+};
+
+// *******************   BPlusTree functionality ********************
+
+template <typename K, typename V, int MinDegree>
+void
+BPlusTree<K, V, MinDegree>::NodeDeleter::operator()(Node* node) const noexcept
+{
+    if (node->m_isLeaf) {
+        delete static_cast<LeafNode*>(node);
+    } else {
+        delete static_cast<InnerNode*>(node);
+    }
+}
+
+template <typename K, typename V, int MinDegree>
+BPlusTree<K, V, MinDegree>&
+BPlusTree<K, V, MinDegree>::operator=(BPlusTree&& other) noexcept
+{
+    if (this != &other) {
+        m_root = std::move(other.m_root);
+        m_count = std::exchange(other.m_count, 0);
+    }
+    return *this;
+}
+
+template <typename K, typename V, int MinDegree>
+int
+BPlusTree<K, V, MinDegree>::lowerIndex(const K* keys, int size, const K& key)
+{
+    if (size == 0) return 0;
+
+    // halving the range without a branch on the comparison, which compiles to a conditional move
+    const K* base = keys;
+    while (size > 1) {
+        int half = size / 2;
+        base = base[half] < key ? base + half : base;
+        size -= half;
+    }
+
+    return int(base - keys) + (*base < key);
+}
+
+template <typename K, typename V, int MinDegree>
+int
+BPlusTree<K, V, MinDegree>::upperIndex(const K* keys, int size, const K& key)
+{
+    if (size == 0) return 0;
+
+    const K* base = keys;
+    while (size > 1) {
+        int half = size / 2;
+        base = !(key < base[half]) ? base + half : base;
+        size -= half;
+    }
+
+    return int(base - keys) + !(key < *base);
+}
+
+template <typename K, typename V, int MinDegree>
+const typename BPlusTree<K, V, MinDegree>::LeafNode*
+BPlusTree<K, V, MinDegree>::findLeaf(const K& key) const
+{
+    const Node* node = m_root.get();
+    while (!node->m_isLeaf) {
+        const InnerNode* inner = asInner(node);
+        // keys equal to a separator are on its right
+        node = inner->m_children[upperIndex(inner->m_keys.data(), inner->m_size, key)].get();
+    }
+
+    return asLeaf(node);
+}
+
+template <typename K, typename V, int MinDegree>
+const V*
+BPlusTree<K, V, MinDegree>::find(const K& key) const
+{
+    if (!m_root) return nullptr;
+
+    const LeafNode* leaf = findLeaf(key);
+    int index = lowerIndex(leaf->m_keys.data(), leaf->m_size, key);
+    if (index < leaf->m_size && leaf->m_keys[index] == key) {
+        return &leaf->m_values[index];
+    }
+
+    return nullptr;
+}
+
+template <typename K, typename V, int MinDegree>
+V*
+BPlusTree<K, V, MinDegree>::find(const K& key)
+{
+    return const_cast<V*>(std::as_const(*this).find(key));
+}
+
+template <typename K, typename V, int MinDegree>
+void
+BPlusTree<K, V, MinDegree>::clear() noexcept
+{
+    m_root.reset();
+    m_count = 0;
+}
+
+template <typename K, typename V, int MinDegree>
+int
+BPlusTree<K, V, MinDegree>::getHeight() const noexcept
+{
+    int height = 0;
+    for (const Node* node = m_root.get(); node; ++height) {
+        node = node->m_isLeaf ? nullptr : asInner(node)->m_children[0].get();
+    }
+
+    return height;
+}
+
+template <typename K, typename V, int MinDegree>
+void
+BPlusTree<K, V, MinDegree>::print() const
+{
+    std::cout << "\n\n";
+    std::queue<const Node*> q;
+    if (m_root) q.push(m_root.get());
+
+    while (!q.empty()) {
+        int size = q.size();
+        while (size--) {
+            const Node* top = q.front();
+            q.pop();
+
+            if (top->m_isLeaf) {
+                const LeafNode* leaf = asLeaf(top);
+                for (int i = 0; i < leaf->m_size; ++i) std::cout << leaf->m_keys[i] << ":" << leaf->m_values[i] << " ";
+            } else {
+                const InnerNode* inner = asInner(top);
+                for (int i = 0; i < inner->m_size; ++i) std::cout << inner->m_keys[i] << " ";
+                for (int i = 0; i <= inner->m_size; ++i) q.push(inner->m_children[i].get());
+            }
+            std::cout << "\t";
+        }
+
+        std::cout << std::endl;
+    }
+}
+
+// *******************   lookups and scans ********************
+
+template <typename K, typename V, int MinDegree>
+typename BPlusTree<K, V, MinDegree>::const_iterator
+BPlusTree<K, V, MinDegree>::begin() const
+{
+    if (!m_root) return end();
+
+    const Node* node = m_root.get();
+    while (!node->m_isLeaf) node = asInner(node)->m_children[0].get();
+
+    return {this, asLeaf(node), 0};
+}
+
+template <typename K, typename V, int MinDegree>
+typename BPlusTree<K, V, MinDegree>::const_iterator
+BPlusTree<K, V, MinDegree>::lower_bound(const K& key) const
+{
+    if (!m_root) return end();
+
+    const LeafNode* leaf = findLeaf(key);
+    int index = lowerIndex(leaf->m_keys.data(), leaf->m_size, key);
+
+    // all keys of the leaf are smaller, the answer starts the next one
+    if (index == leaf->m_size) return {this, leaf->m_next, 0};
+    return {this, leaf, index};
+}
+
+template <typename K, typename V, int MinDegree>
+typename BPlusTree<K, V, MinDegree>::const_iterator
+BPlusTree<K, V, MinDegree>::upper_bound(const K& key) const
+{
+    if (!m_root) return end();
+
+    const LeafNode* leaf = findLeaf(key);
+    int index = upperIndex(leaf->m_keys.data(), leaf->m_size, key);
+
+    if (index == leaf->m_size) return {this, leaf->m_next, 0};
+    return {this, leaf, index};
+}
+
+template <typename K, typename V, int MinDegree>
+template <typename Visitor>
+void
+BPlusTree<K, V, MinDegree>::rangeScan(const K& lo, const K& hi, Visitor&& visit) const
+{
+    const_iterator from = lower_bound(lo);
+
+    int index = from.m_index;
+    for (const LeafNode* leaf = from.m_leaf; leaf; leaf = leaf->m_next, index = 0) {
+        for (; index < leaf->m_size; ++index) {
+            if (!(leaf->m_keys[index] < hi)) return;
+
+            if constexpr (std::is_same_v<std::invoke_result_t<Visitor&, const K&, const V&>, bool>) {
+                if (!visit(leaf->m_keys[index], leaf->m_values[index])) return;
+            } else {
+                visit(leaf->m_keys[index], leaf->m_values[index]);
+            }
+        }
+    }
+}
+
+template <typename K, typename V, int MinDegree>
+typename BPlusTree<K, V, MinDegree>::const_iterator&
+BPlusTree<K, V, MinDegree>::const_iterator::operator++() noexcept
+{
+    if (++m_index == m_leaf->m_size) {
+        m_leaf = m_leaf->m_next;
+        m_index = 0;
+    }
+    return *this;
+}
+
+template <typename K, typename V, int MinDegree>
+typename BPlusTree<K, V, MinDegree>::const_iterator&
+BPlusTree<K, V, MinDegree>::const_iterator::operator--() noexcept
+{
+    if (!m_leaf) {
+        // from end() to the last entry of the last leaf
+        const Node* node = m_tree->m_root.get();
+        while (!node->m_isLeaf) node = asInner(node)->m_children[node->m_size].get();
+        m_leaf = asLeaf(node);
+        m_index = m_leaf->m_size - 1;
+    } else if (m_index == 0) {
+        m_leaf = m_leaf->m_prev;
+        m_index = m_leaf->m_size - 1;
+    } else {
+        --m_index;
+    }
+    return *this;
+}
+
+// *******************   insert ********************
+
+template <typename K, typename V, int MinDegree>
+bool
+BPlusTree<K, V, MinDegree>::insert(const K& key, const V& value)
+{
+    if (!m_root) {
+        m_root = NodePtr{new LeafNode};
+    }
+
+    bool inserted = false;
+    Split split = insertHelper(m_root.get(), key, value, inserted);
+
+    // the root has split, the tree grows by one level
+    if (split.right) {
+        InnerNode* root = new InnerNode;
+        root->m_keys[0] = split.key;
+        root->m_children[0] = std::move(m_root);
+        root->m_children[1] = std::move(split.right);
+        root->m_size = 1;
+        m_root = NodePtr{root};
+    }
+
+    if (inserted) ++m_count;
+    return inserted;
+}
+
+template <typename K, typename V, int MinDegree>
+typename BPlusTree<K, V, MinDegree>::Split
+BPlusTree<K, V, MinDegree>::insertHelper(Node* node, const K& key, const V& value, bool& inserted)
+{
+    if (node->m_isLeaf) {
+        LeafNode* leaf = asLeaf(node);
+        int index = lowerIndex(leaf->m_keys.data(), leaf->m_size, key);
+        if (index < leaf->m_size && leaf->m_keys[index] == key) {
+            leaf->m_values[index] = value;
+            return {};
+        }
+
+        inserted = true;
+        if (leaf->m_size < maxKeys) {
+            insertIntoLeaf(leaf, index, key, value);
+            return {};
+        }
+
+        // the full leaf keeps its first t - 1 entries, the last t go to a new leaf after it
+        myDS::stats::count(myDS::stats::nodeSplits);
+        LeafNode* right = new LeafNode;
+        NodePtr rightPtr{right};
+        for (int i = 0; i < m_t; ++i) {
+            right->m_keys[i] = std::move(leaf->m_keys[i + m_t - 1]);
+            right->m_values[i] = std::move(leaf->m_values[i + m_t - 1]);
+        }
+        right->m_size = m_t;
+        leaf->m_size = m_t - 1;
+
+        right->m_next = leaf->m_next;
+        if (leaf->m_next) leaf->m_next->m_prev = right;
+        right->m_prev = leaf;
+        leaf->m_next = right;
+
+        if (index < m_t) {
+            insertIntoLeaf(leaf, index, key, value);
+        } else {
+            insertIntoLeaf(right, index - (m_t - 1), key, value);
+        }
+
+        // the separator is copied up, the entry stays in the leaf
+        return {right->m_keys[0], std::move(rightPtr)};
+    }
+
+    InnerNode* inner = asInner(node);
+    int index = upperIndex(inner->m_keys.data(), inner->m_size, key);
+    Split split = insertHelper(inner->m_children[index].get(), key, value, inserted);
+    if (!split.right) return {};
+
+    if (inner->m_size < maxKeys) {
+        insertIntoInner(inner, index, split.key, std::move(split.right));
+        return {};
+    }
+
+    // the full node keeps its first t - 1 keys, the key after them goes up,
+    // the last t - 1 keys and t children go to a new node
+    myDS::stats::count(myDS::stats::nodeSplits);
+    InnerNode* right = new InnerNode;
+    NodePtr rightPtr{right};
+    K up = std::move(inner->m_keys[m_t - 1]);
+    for (int i = 0; i < m_t - 1; ++i) {
+        right->m_keys[i] = std::move(inner->m_keys[i + m_t]);
+    }
+    for (int i = 0; i < m_t; ++i) {
+        right->m_children[i] = std::move(inner->m_children[i + m_t]);
+    }
+    right->m_size = m_t - 1;
+    inner->m_size = m_t - 1;
+
+    if (index < m_t) {
+        insertIntoInner(inner, index, split.key, std::move(split.right));
+    } else {
+        insertIntoInner(right, index - m_t, split.key, std::move(split.right));
+    }
+
+    return {std::move(up), std::move(rightPtr)};
+}
+
+template <typename K, typename V, int MinDegree>
+void
+BPlusTree<K, V, MinDegree>::insertIntoLeaf(LeafNode* leaf, int index, const K& key, const V& value)
+{
+    for (int i = leaf->m_size; i > index; --i) {
+        leaf->m_keys[i] = std::move(leaf->m_keys[i - 1]);
+        leaf->m_values[i] = std::move(leaf->m_values[i - 1]);
+    }
+
+    leaf->m_keys[index] = key;
+    leaf->m_values[index] = value;
+    ++leaf->m_size;
+}
+
+template <typename K, typename V, int MinDegree>
+void
+BPlusTree<K, V, MinDegree>::insertIntoInner(InnerNode* node, int index, const K& key, NodePtr child)
+{
+    for (int i = node->m_size; i > index; --i) {
+        node->m_keys[i] = std::move(node->m_keys[i - 1]);
+        node->m_children[i + 1] = std::move(node->m_children[i]);
+    }
+
+    node->m_keys[index] = key;
+    node->m_children[index + 1] = std::move(child);
+    ++node->m_size;
+}
+
+// *******************   erase ********************
+
+template <typename K, typename V, int MinDegree>
+bool
+BPlusTree<K, V, MinDegree>::erase(const K& key)
+{
+    if (!m_root || !eraseHelper(m_root.get(), key)) return false;
+
+    --m_count;
+
+    // If after the erase the root has no keys
+    // make its only child the new root, an empty leaf root leaves the tree empty
+    if (m_root->m_size == 0) {
+        if (m_root->m_isLeaf) {
+            m_root.reset();
+        } else {
+            m_root = std::move(asInner(m_root.get())->m_children[0]);
+        }
+    }
+
+    return true;
+}
+
+template <typename K, typename V, int MinDegree>
+bool
+BPlusTree<K, V, MinDegree>::eraseHelper(Node* node, const K& key)
+{
+    if (node->m_isLeaf) {
+        LeafNode* leaf = asLeaf(node);
+        int index = lowerIndex(leaf->m_keys.data(), leaf->m_size, key);
+        if (index == leaf->m_size || !(leaf->m_keys[index] == key)) return false;
+
+        for (int i = index + 1; i < leaf->m_size; ++i) {
+            leaf->m_keys[i - 1] = std::move(leaf->m_keys[i]);
+            leaf->m_values[i - 1] = std::move(leaf->m_values[i]);
+        }
+        --leaf->m_size;
+        return true;
+    }
+
+    // unlike in BTree the separators may stay after their key is gone, they still bound the subtrees
+    InnerNode* inner = asInner(node);
+    int index = upperIndex(inner->m_keys.data(), inner->m_size, key);
+    if (!eraseHelper(inner->m_children[index].get(), key)) return false;
+
+    if (inner->m_children[index]->m_size < m_t - 1) {
+        fill(inner, index); // solves the problem of underflow
+    }
+    return true;
+}
+
+template <typename K, typename V, int MinDegree>
+void
+BPlusTree<K, V, MinDegree>::fill(InnerNode* parent, int index)
+{
+    if (index != 0 && parent->m_children[index - 1]->m_size >= m_t) {
+        borrowFromPrev(parent, index);
+    } else if (index != parent->m_size && parent->m_children[index + 1]->m_size >= m_t) {
+        borrowFromNext(parent, index);
+    } else if (index != parent->m_size) {
+        merge(parent, index);
+    } else {
+        merge(parent, index - 1);
+    }
+}
+
+template <typename K, typename V, int MinDegree>
+void
+BPlusTree<K, V, MinDegree>::borrowFromPrev(InnerNode* parent, int index)
+{
+    Node* child = parent->m_children[index].get();
+    Node* sibling = parent->m_children[index - 1].get();
+
+    if (child->m_isLeaf) {
+        // the last entry of the sibling becomes the first of the child and the new separator
+        LeafNode* leaf = asLeaf(child);
+        LeafNode* prev = asLeaf(sibling);
+        insertIntoLeaf(leaf, 0, prev->m_keys[prev->m_size - 1], prev->m_values[prev->m_size - 1]);
+        --prev->m_size;
+        parent->m_keys[index - 1] = leaf->m_keys[0];
+        return;
+    }
+
+    // the separator comes down in front of the child's keys, the sibling's last key goes up
+    InnerNode* node = asInner(child);
+    InnerNode* prev = asInner(sibling);
+    for (int i = node->m_size; i > 0; --i) {
+        node->m_keys[i] = std::move(node->m_keys[i - 1]);
+    }
+    for (int i = node->m_size + 1; i > 0; --i) {
+        node->m_children[i] = std::move(node->m_children[i - 1]);
+    }
+
+    node->m_keys[0] = std::move(parent->m_keys[index - 1]);
+    node->m_children[0] = std::move(prev->m_children[prev->m_size]);
+    parent->m_keys[index - 1] = std::move(prev->m_keys[prev->m_size - 1]);
+
+    ++node->m_size;
+    --prev->m_size;
+}
+
+template <typename K, typename V, int MinDegree>
+void
+BPlusTree<K, V, MinDegree>::borrowFromNext(InnerNode* parent, int index)
+{
+    Node* child = parent->m_children[index].get();
+    Node* sibling = parent->m_children[index + 1].get();
+
+    if (child->m_isLeaf) {
+        // the first entry of the sibling goes to the end of the child, the sibling's new first key separates them
+        LeafNode* leaf = asLeaf(child);
+        LeafNode* next = asLeaf(sibling);
+        leaf->m_keys[leaf->m_size] = std::move(next->m_keys[0]);
+        leaf->m_values[leaf->m_size] = std::move(next->m_values[0]);
+        ++leaf->m_size;
+
+        for (int i = 1; i < next->m_size; ++i) {
+            next->m_keys[i - 1] = std::move(next->m_keys[i]);
+            next->m_values[i - 1] = std::move(next->m_values[i]);
+        }
+        --next->m_size;
+        parent->m_keys[index] = next->m_keys[0];
+        return;
+    }
+
+    // the separator comes down after the child's keys, the sibling's first key goes up
+    InnerNode* node = asInner(child);
+    InnerNode* next = asInner(sibling);
+    node->m_keys[node->m_size] = std::move(parent->m_keys[index]);
+    node->m_children[node->m_size + 1] = std::move(next->m_children[0]);
+    parent->m_keys[index] = std::move(next->m_keys[0]);
+
+    for (int i = 1; i < next->m_size; ++i) {
+        next->m_keys[i - 1] = std::move(next->m_keys[i]);
+    }
+    for (int i = 1; i <= next->m_size; ++i) {
+        next->m_children[i - 1] = std::move(next->m_children[i]);
+    }
+
+    ++node->m_size;
+    --next->m_size;
+}
+
+template <typename K, typename V, int MinDegree>
+void
+BPlusTree<K, V, MinDegree>::merge(InnerNode* parent, int index)
+{
+    Node* child = parent->m_children[index].get();
+    // the sibling is freed when this function returns
+    NodePtr sibling = std::move(parent->m_children[index + 1]);
+
+    if (child->m_isLeaf) {
+        // leaves drop the separator, it is not an entry
+        LeafNode* leaf = asLeaf(child);
+        LeafNode* next = asLeaf(sibling.get());
+        for (int i = 0; i < next->m_size; ++i) {
+            leaf->m_keys[leaf->m_size + i] = std::move(next->m_keys[i]);
+            leaf->m_values[leaf->m_size + i] = std::move(next->m_values[i]);
+        }
+        leaf->m_size += next->m_size;
+
+        leaf->m_next = next->m_next;
+        if (next->m_next) next->m_next->m_prev = leaf;
+    } else {
+        // inner nodes pull the separator down between their keys
+        InnerNode* node = asInner(child);
+        InnerNode* next = asInner(sibling.get());
+        node->m_keys[node->m_size] = std::move(parent->m_keys[index]);
+        for (int i = 0; i < next->m_size; ++i) {
+            node->m_keys[node->m_size + 1 + i] = std::move(next->m_keys[i]);
+        }
+        for (int i = 0; i <= next->m_size; ++i) {
+            node->m_children[node->m_size + 1 + i] = std::move(next->m_children[i]);
+        }
+        node->m_size += next->m_size + 1;
+    }
+
+    // close the gap left by the separator and the sibling in the parent
+    for (int i = index + 1; i < parent->m_size; ++i) {
+        parent->m_keys[i - 1] = std::move(parent->m_keys[i]);
+    }
+    for (int i = index + 2; i <= parent->m_size; ++i) {
+        parent->m_children[i - 1] = std::move(parent->m_children[i]);
+    }
+    --parent->m_size;
+}
+
+// *******************   bulk loading ********************
+
+template <typename K, typename V, int MinDegree>
+template <typename It>
+void
+BPlusTree<K, V, MinDegree>::bulkLoad(It first, It last, double fillFactor)
+{
+    clear();
+
+    const int leafSize = std::clamp(int(fillFactor * maxKeys + 0.5), m_t - 1, maxKeys);
+    const int innerSize = std::clamp(int(fillFactor * (maxKeys + 1) + 0.5), m_t, maxKeys + 1); // children
+
+    // the nodes of the level being built, with the smallest key of each of them
+    std::vector<NodePtr> level;
+    std::vector<K> minKeys;
+
+    LeafNode* leaf = nullptr;
+    for (; first != last; ++first) {
+        auto&& entry = *first;
+        if (leaf && leaf->m_keys[leaf->m_size - 1] == entry.first) {
+            leaf->m_values[leaf->m_size - 1] = entry.second;
+            continue;
+        }
+
+        if (!leaf || leaf->m_size == leafSize) {
+            LeafNode* next = new LeafNode;
+            level.push_back(NodePtr{next});
+            minKeys.push_back(entry.first);
+
+            next->m_prev = leaf;
+            if (leaf) leaf->m_next = next;
+            leaf = next;
+        }
+
+        leaf->m_keys[leaf->m_size] = entry.first;
+        leaf->m_values[leaf->m_size] = entry.second;
+        ++leaf->m_size;
+        ++m_count;
+    }
+
+    if (level.empty()) return;
+    balanceLastLeaves(level, minKeys);
+
+    // group the nodes of each level under new inner nodes until one node is left
+    while (level.size() > 1) {
+        std::vector<NodePtr> parents;
+        std::vector<K> parentMinKeys;
+
+        InnerNode* node = nullptr;
+        for (std::size_t i = 0; i < level.size(); ++i) {
+            if (!node || node->m_size + 1 == innerSize) {
+                node = new InnerNode;
+                parents.push_back(NodePtr{node});
+                parentMinKeys.push_back(std::move(minKeys[i]));
+                node->m_children[0] = std::move(level[i]);
+                continue;
+            }
+
+            node->m_keys[node->m_size] = std::move(minKeys[i]);
+            node->m_children[node->m_size + 1] = std::move(level[i]);
+            ++node->m_size;
+        }
+
+        balanceLastInners(parents, parentMinKeys);
+        level = std::move(parents);
+        minKeys = std::move(parentMinKeys);
+    }
+
+    m_root = std::move(level[0]);
+}
+
+template <typename K, typename V, int MinDegree>
+void
+BPlusTree<K, V, MinDegree>::balanceLastLeaves(std::vector<NodePtr>& level, std::vector<K>& minKeys)
+{
+    if (level.size() < 2 || level.back()->m_size >= m_t - 1) return;
+
+    LeafNode* prev = asLeaf(level[level.size() - 2].get());
+    LeafNode* tail = asLeaf(level.back().get());
+    int total = prev->m_size + tail->m_size;
+
+    if (total <= maxKeys) {
+        // both fit into one leaf
+        for (int i = 0; i < tail->m_size; ++i) {
+            prev->m_keys[prev->m_size + i] = std::move(tail->m_keys[i]);
+            prev->m_values[prev->m_size + i] = std::move(tail->m_values[i]);
+        }
+        prev->m_size = total;
+        prev->m_next = nullptr;
+
+        level.pop_back();
+        minKeys.pop_back();
+        return;
+    }
+
+    // otherwise half of the entries each, both end up with at least t entries
+    int moved = total / 2 - tail->m_size;
+    for (int i = tail->m_size - 1; i >= 0; --i) {
+        tail->m_keys[i + moved] = std::move(tail->m_keys[i]);
+        tail->m_values[i + moved] = std::move(tail->m_values[i]);
+    }
+    for (int i = 0; i < moved; ++i) {
+        tail->m_keys[i] = std::move(prev->m_keys[prev->m_size - moved + i]);
+        tail->m_values[i] = std::move(prev->m_values[prev->m_size - moved + i]);
+    }
+    prev->m_size -= moved;
+    tail->m_size += moved;
+    minKeys.back() = tail->m_keys[0];
+}
+
+template <typename K, typename V, int MinDegree>
+void
+BPlusTree<K, V, MinDegree>::balanceLastInners(std::vector<NodePtr>& level, std::vector<K>& minKeys)
+{
+    if (level.size() < 2 || level.back()->m_size >= m_t - 1) return;
+
+    InnerNode* prev = asInner(level[level.size() - 2].get());
+    InnerNode* tail = asInner(level.back().get());
+
+    if (prev->m_size + tail->m_size + 1 <= maxKeys) {
+        // both fit into one node, the smallest key of the tail separates them
+        prev->m_keys[prev->m_size] = std::move(minKeys.back());
+        for (int i = 0; i < tail->m_size; ++i) {
+            prev->m_keys[prev->m_size + 1 + i] = std::move(tail->m_keys[i]);
+        }
+        for (int i = 0; i <= tail->m_size; ++i) {
+            prev->m_children[prev->m_size + 1 + i] = std::move(tail->m_children[i]);
+        }
+        prev->m_size += tail->m_size + 1;
+
+        level.pop_back();
+        minKeys.pop_back();
+        return;
+    }
+
+    // otherwise move the last children of prev to the tail one at a time, as borrowFromPrev does
+    while (tail->m_size < m_t - 1) {
+        for (int i = tail->m_size; i > 0; --i) {
+            tail->m_keys[i] = std::move(tail->m_keys[i - 1]);
+        }
+        for (int i = tail->m_size + 1; i > 0; --i) {
+            tail->m_children[i] = std::move(tail->m_children[i - 1]);
+        }
+
+        tail->m_keys[0] = std::move(minKeys.back());
+        tail->m_children[0] = std::move(prev->m_children[prev->m_size]);
+        minKeys.back() = std::move(prev->m_keys[prev->m_size - 1]);
+
+        ++tail->m_size;
+        --prev->m_size;
+    }
+}
@@ -0,0 +1,546 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <list>
+#include <memory>
+#include <new>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace myDS {
+
+    /*
+    * Node storage for BTree. The nodes refer to their children through Storage::Link:
+    *   Link                  child reference kept in a node, a default constructed Link is null
+    *   Ref                   copyable reference to a node that keeps nothing in memory, iterators hold these
+    *   ref(link)             the Ref of the node behind a link
+    *   get(link), get(ref)   the node behind a link or a Ref
+    *   create(args...)       constructs a node and returns its link
+    *   destroy(link)         frees the node behind link
+    *   Context(storage, w)   scope of one tree operation, w says whether it changes nodes,
+    *                         get, create and destroy are called inside one
+    *   Scope                 the nodes got while it lives may be evicted once it ends, the node
+    *                         algorithms open one for every step down the tree
+    *   loadRoot()            root stored by the last checkpoint
+    *   checkpoint(root)      makes the nodes and the root durable, false on an I/O error
+    * get, create and destroy are static so that the node algorithms need no pointer back to the tree.
+    */
+
+    // Nodes on the heap, owned by their parent through unique_ptr.
+    template <typename Node>
+    class InMemoryStorage {
+    public:
+        using Link = std::unique_ptr<Node>;
+        using Ref = Node*;
+
+        struct Context {
+            Context(const InMemoryStorage&, bool) noexcept { }
+        };
+
+        struct Scope {
+            Scope() noexcept { }
+        };
+
+        static Ref ref(const Link& link) noexcept { return link.get(); }
+
+        static Node* get(const Link& link) noexcept { return link.get(); }
+        static Node* get(Ref ref) noexcept { return ref; }
+
+        template <typename... Args>
+        static Link create(Args&&... args) {
+            return std::make_unique<Node>(std::forward<Args>(args)...);
+        }
+
+        static void destroy(Link& link) noexcept { link.reset(); }
+
+        Link loadRoot() const noexcept { return nullptr; }
+
+        bool checkpoint(const Link&) noexcept { return true; }
+    };
+
+    // Largest minimum degree whose node fits into a page of pageSize bytes: 2t - 1 keys,
+    // 2t links of 8 bytes and the size and leaf fields.
+    template <typename T>
+    constexpr int degreeForPage(std::size_t pageSize = 4096) {
+        auto nodeSize = [](std::size_t t) {
+            std::size_t keys = (2 * t - 1) * sizeof(T);
+            keys = (keys + 7) / 8 * 8;
+            return keys + 2 * t * sizeof(std::uint64_t) + 8;
+        };
+
+        std::size_t t = 2;
+        while (nodeSize(t + 1) <= pageSize) ++t;
+        return int(t);
+    }
+
+    /*
+    * Nodes in fixed size pages of a file (POSIX). Page 0 is the file header, the others hold one node
+    * each or belong to the free list, and a Link is a page number.
+    *
+    * Pages are read through an LRU buffer pool of page aligned frames. A page stays pinned, and the node
+    * pointers into it valid, until the Scope it was fetched in ends, or the outermost Context if no Scope
+    * is open. The node algorithms open a Scope for every step down the tree and iterators fetch their
+    * nodes again on every step, so an operation pins only the nodes along its path. The pool grows past
+    * its capacity rather than evict a pinned page and shrinks back when the outermost Context ends.
+    *
+    * A page fetched in a writing Context is dirty. Dirty pages are written back when they are evicted
+    * and by checkpoint(), which syncs them before it writes the header with the new root and syncs
+    * again. The pages are overwritten in place, by evictions between checkpoints too, so a crash
+    * between two checkpoints can corrupt the file: the header of the last checkpoint may then refer
+    * to pages that have been changed or reused since. There is no recovery, keep a copy of a file
+    * that has to survive a crash.
+    *
+    * Opened with mmap, the file is mapped read-only and get() returns pointers into the mapping,
+    * which works without a pool but doesn't allow any change to the tree.
+    *
+    * The nodes are copied to and from the file as bytes, so they must be trivially copyable.
+    */
+    template <typename Node, std::size_t PageSize = 4096>
+    class PagedStorage {
+        static_assert(PageSize >= 512 && (PageSize & (PageSize - 1)) == 0, "pages are a power of two of at least 512 bytes");
+
+    public:
+        using Link = std::uint64_t;
+
+        struct Options {
+            std::size_t poolPages{1024}; // frames kept before the pool starts to evict
+            bool mmapReadOnly{false};
+        };
+
+        // Opens or creates the file at path, nothing if it can't be opened or was written with a different
+        // page or node size.
+        static std::optional<PagedStorage> open(const char* path, Options options = {});
+
+        PagedStorage(const PagedStorage&) = delete;
+        PagedStorage& operator=(const PagedStorage&) = delete;
+
+        PagedStorage(PagedStorage&& other) noexcept { swap(other); }
+
+        PagedStorage& operator=(PagedStorage&& other) noexcept {
+            if (this != &other) {
+                PagedStorage{std::move(other)}.swap(*this);
+            }
+            return *this;
+        }
+
+        // changes since the last checkpoint are not written, BTree checkpoints when it is destroyed
+        ~PagedStorage() { close(); }
+
+        // Makes its storage the current one of this thread. Contexts nest, the outermost context of the
+        // storage pins the pages fetched outside of a Scope until it ends, so that the node pointers
+        // handed out by an inner one (search() under pin()) stay valid. Reading only fills the pool,
+        // which is why a const storage will do.
+        class Context {
+        public:
+            Context(const PagedStorage& storage, bool write)
+                : m_storage{const_cast<PagedStorage*>(&storage)}, m_prev{s_current}, m_write{write}
+            {
+                assert(!(write && m_storage->m_map));
+                s_current = m_storage;
+                if (m_storage->m_contextDepth++ == 0) m_storage->openScope();
+                if (m_write) ++m_storage->m_writeDepth;
+            }
+
+            Context(const Context&) = delete;
+            Context& operator=(const Context&) = delete;
+
+            ~Context() {
+                if (--m_storage->m_contextDepth == 0) {
+                    m_storage->closeScope(0);
+                    m_storage->shrink();
+                }
+
+                if (m_write) --m_storage->m_writeDepth;
+                s_current = m_prev;
+            }
+
+        private:
+            PagedStorage* m_storage;
+            PagedStorage* m_prev;
+            bool m_write;
+        };
+
+        // Unpins the pages fetched while it lives when it ends, unless an enclosing scope pinned them too.
+        class Scope {
+        public:
+            Scope() : m_storage{&current()}, m_mark{m_storage->openScope()} { }
+
+            Scope(const Scope&) = delete;
+            Scope& operator=(const Scope&) = delete;
+
+            ~Scope() { m_storage->closeScope(m_mark); }
+
+        private:
+            PagedStorage* m_storage;
+            std::size_t m_mark;
+        };
+
+        using Ref = Link;
+
+        static Ref ref(Link link) noexcept { return link; }
+
+        static Node* get(Link link) {
+            PagedStorage& storage = current();
+            assert(link != 0);
+
+            if (storage.m_map) {
+                return std::launder(reinterpret_cast<Node*>(storage.m_map + link * PageSize));
+            }
+            return std::launder(reinterpret_cast<Node*>(storage.fetch(link, true)));
+        }
+
+        template <typename... Args>
+        static Link create(Args&&... args) {
+            static_assert(std::is_trivially_copyable_v<Node>, "paged nodes are stored as bytes");
+            static_assert(sizeof(Node) <= PageSize, "a node must fit into a page, see degreeForPage");
+
+            PagedStorage* storage = &current();
+            assert(!storage->m_map && storage->m_writeDepth > 0);
+
+            Link link;
+            unsigned char* page;
+            if (storage->m_freeHead != 0) {
+                // a freed page keeps the next free page in its first bytes
+                link = storage->m_freeHead;
+                page = storage->fetch(link, true);
+                std::memcpy(&storage->m_freeHead, page, sizeof(Link));
+            } else {
+                link = storage->m_pageCount++;
+                page = storage->fetch(link, false);
+            }
+
+            ::new (static_cast<void*>(page)) Node(std::forward<Args>(args)...);
+            return link;
+        }
+
+        static void destroy(Link& link) {
+            PagedStorage* storage = &current();
+            assert(!storage->m_map && storage->m_writeDepth > 0);
+
+            unsigned char* page = storage->fetch(link, true);
+            std::memcpy(page, &storage->m_freeHead, sizeof(Link));
+            storage->m_freeHead = link;
+            link = 0;
+        }
+
+        Link loadRoot() const noexcept { return m_root; }
+
+        bool checkpoint(Link root);
+
+        // pages in the file, the header included
+        std::size_t pageCount() const noexcept { return m_pageCount; }
+
+    private:
+        struct Header {
+            std::uint64_t magic;
+            std::uint64_t pageSize;
+            std::uint64_t nodeSize;
+            std::uint64_t pageCount;
+            Link root;
+            Link freeHead;
+        };
+
+        struct FreeDeleter {
+            void operator()(unsigned char* p) const noexcept { std::free(p); }
+        };
+
+        struct Frame {
+            std::unique_ptr<unsigned char, FreeDeleter> data;
+            Link link{0};
+            int pins{0};     // entries of m_pinned for the frame
+            int pinDepth{0}; // depth of the innermost scope that pinned the frame, 0 if none
+            bool dirty{false};
+            std::list<std::size_t>::iterator lruPos; // valid while not pinned
+        };
+
+        // a frame pinned in a scope, with the pinDepth it had before
+        struct Pin {
+            std::size_t index;
+            int prevDepth;
+        };
+
+        static constexpr std::uint64_t magic{0x31675065'65725442}; // "BTreePg1" in little endian
+
+        PagedStorage() { }
+
+        void swap(PagedStorage& other) noexcept;
+
+        // the storage of the innermost Context of this thread
+        static PagedStorage& current() {
+            if (!s_current) throw std::logic_error("PagedStorage: nodes used outside of a Context, see BTree::pin()");
+            return *s_current;
+        }
+
+        // the frame of the page, read from the file if read, pinned in the innermost scope
+        unsigned char* fetch(Link link, bool read);
+
+        // opens a scope and returns the mark closeScope takes
+        std::size_t openScope() noexcept {
+            ++m_pinDepth;
+            return m_pinned.size();
+        }
+
+        // unpins what the innermost scope pinned since mark
+        void closeScope(std::size_t mark) noexcept;
+
+        // evicts the least recently used pages until the pool is back at its capacity, no page may be pinned
+        void shrink();
+
+        // a frame that holds no page, evicting the least recently used one if the pool is full
+        std::size_t freeFrame();
+
+        bool writePage(Link link, const unsigned char* data);
+        bool writeHeader(Link root);
+
+        void close() noexcept;
+
+        static inline thread_local PagedStorage* s_current{nullptr};
+
+    private:
+        int m_fd{-1};
+        unsigned char* m_map{nullptr};
+        std::size_t m_mapSize{0};
+        std::size_t m_capacity{0};
+
+        std::vector<Frame> m_frames;
+        std::unordered_map<Link, std::size_t> m_table; // page to frame
+        std::list<std::size_t> m_lru;                  // unpinned frames, least recently used first
+        std::vector<Pin> m_pinned;                     // frames pinned by the open scopes, once per scope
+        int m_contextDepth{0};
+        int m_pinDepth{0};                             // open scopes, the outermost context included
+        int m_writeDepth{0};
+        bool m_failed{false};                          // an I/O error since the last checkpoint
+
+        std::uint64_t m_pageCount{1};
+        Link m_root{0};
+        Link m_freeHead{0};
+    };
+
+    template <typename Node, std::size_t PageSize>
+    std::optional<PagedStorage<Node, PageSize>>
+    PagedStorage<Node, PageSize>::open(const char* path, Options options)
+    {
+        PagedStorage storage;
+        // the page used last stays cached, so that a key an operation returns a reference to does too
+        storage.m_capacity = std::max<std::size_t>(options.poolPages, 1);
+        storage.m_fd = options.mmapReadOnly ? ::open(path, O_RDONLY) : ::open(path, O_RDWR | O_CREAT, 0644);
+        if (storage.m_fd < 0) return std::nullopt;
+
+        struct stat st;
+        if (::fstat(storage.m_fd, &st) != 0) return std::nullopt;
+
+        if (st.st_size == 0) {
+            if (options.mmapReadOnly || !storage.writeHeader(0)) return std::nullopt;
+            return storage;
+        }
+
+        Header header;
+        if (::pread(storage.m_fd, &header, sizeof(header), 0) != ssize_t(sizeof(header))) return std::nullopt;
+        if (header.magic != magic || header.pageSize != PageSize || header.nodeSize != sizeof(Node)) return std::nullopt;
+
+        storage.m_pageCount = header.pageCount;
+        storage.m_root = header.root;
+        storage.m_freeHead = header.freeHead;
+
+        if (options.mmapReadOnly) {
+            storage.m_mapSize = header.pageCount * PageSize;
+            void* map = ::mmap(nullptr, storage.m_mapSize, PROT_READ, MAP_SHARED, storage.m_fd, 0);
+            if (map == MAP_FAILED) return std::nullopt;
+            storage.m_map = static_cast<unsigned char*>(map);
+        }
+
+        return storage;
+    }
+
+    template <typename Node, std::size_t PageSize>
+    bool
+    PagedStorage<Node, PageSize>::checkpoint(Link root)
+    {
+        if (m_fd < 0 || m_map) return !m_failed;
+
+        for (Frame& frame : m_frames) {
+            if (frame.link != 0 && frame.dirty) {
+                if (writePage(frame.link, frame.data.get())) frame.dirty = false;
+            }
+        }
+
+        // the header may refer to the pages only once they are on disk
+        bool ok = !m_failed && ::fdatasync(m_fd) == 0 && writeHeader(root) && ::fdatasync(m_fd) == 0;
+        m_root = root;
+        m_failed = false;
+        return ok;
+    }
+
+    template <typename Node, std::size_t PageSize>
+    unsigned char*
+    PagedStorage<Node, PageSize>::fetch(Link link, bool read)
+    {
+        std::size_t index;
+        auto found = m_table.find(link);
+        if (found != m_table.end()) {
+            index = found->second;
+            if (m_frames[index].pins == 0) m_lru.erase(m_frames[index].lruPos);
+        } else {
+            index = freeFrame();
+            Frame& frame = m_frames[index];
+            frame.link = link;
+            frame.dirty = false;
+
+            // a page past the end of the file is new
+            unsigned char* data = frame.data.get();
+            if (!read || ::pread(m_fd, data, PageSize, off_t(link * PageSize)) != ssize_t(PageSize)) {
+                if (read) m_failed = true;
+                std::memset(data, 0, PageSize);
+            }
+            m_table.emplace(link, index);
+        }
+
+        // a page fetched again in the same scope is pinned once
+        Frame& frame = m_frames[index];
+        if (frame.pinDepth != m_pinDepth) {
+            m_pinned.push_back({index, frame.pinDepth});
+            ++frame.pins;
+            frame.pinDepth = m_pinDepth;
+        }
+        if (m_writeDepth > 0) frame.dirty = true;
+        return frame.data.get();
+    }
+
+    template <typename Node, std::size_t PageSize>
+    void
+    PagedStorage<Node, PageSize>::closeScope(std::size_t mark) noexcept
+    {
+        // in the order they were pinned, so that the pages used last are the most recently used ones
+        for (std::size_t i = mark; i < m_pinned.size(); ++i) {
+            Frame& frame = m_frames[m_pinned[i].index];
+            frame.pinDepth = m_pinned[i].prevDepth;
+            if (--frame.pins == 0) {
+                m_lru.push_back(m_pinned[i].index);
+                frame.lruPos = std::prev(m_lru.end());
+            }
+        }
+
+        m_pinned.resize(mark);
+        --m_pinDepth;
+    }
+
+    template <typename Node, std::size_t PageSize>
+    void
+    PagedStorage<Node, PageSize>::shrink()
+    {
+        if (m_frames.size() <= m_capacity) return;
+        assert(m_pinned.empty() && m_lru.size() == m_frames.size());
+
+        while (m_lru.size() > m_capacity) {
+            Frame& frame = m_frames[m_lru.front()];
+            if (frame.dirty) writePage(frame.link, frame.data.get());
+            m_table.erase(frame.link);
+            m_lru.pop_front();
+        }
+
+        // the frames left are renumbered in their LRU order
+        std::vector<Frame> frames;
+        frames.reserve(m_lru.size());
+        for (auto pos = m_lru.begin(); pos != m_lru.end(); ++pos) {
+            frames.push_back(std::move(m_frames[*pos]));
+            *pos = frames.size() - 1;
+            frames.back().lruPos = pos;
+            m_table[frames.back().link] = *pos;
+        }
+        m_frames.swap(frames);
+    }
+
+    template <typename Node, std::size_t PageSize>
+    std::size_t
+    PagedStorage<Node, PageSize>::freeFrame()
+    {
+        if (m_frames.size() < m_capacity || m_lru.empty()) {
+            Frame frame;
+            frame.data.reset(static_cast<unsigned char*>(std::aligned_alloc(PageSize, PageSize)));
+            if (!frame.data) throw std::bad_alloc{};
+
+            m_frames.push_back(std::move(frame));
+            return m_frames.size() - 1;
+        }
+
+        std::size_t victim = m_lru.front();
+        m_lru.pop_front();
+
+        Frame& frame = m_frames[victim];
+        if (frame.dirty) writePage(frame.link, frame.data.get());
+        m_table.erase(frame.link);
+        frame.link = 0;
+        return victim;
+    }
+
+    template <typename Node, std::size_t PageSize>
+    bool
+    PagedStorage<Node, PageSize>::writePage(Link link, const unsigned char* data)
+    {
+        if (::pwrite(m_fd, data, PageSize, off_t(link * PageSize)) == ssize_t(PageSize)) return true;
+
+        m_failed = true;
+        return false;
+    }
+
+    template <typename Node, std::size_t PageSize>
+    bool
+    PagedStorage<Node, PageSize>::writeHeader(Link root)
+    {
+        // the header page is written whole so that the first node page starts at PageSize
+        std::unique_ptr<unsigned char, FreeDeleter> page{static_cast<unsigned char*>(std::aligned_alloc(PageSize, PageSize))};
+        if (!page) return false;
+
+        std::memset(page.get(), 0, PageSize);
+        Header header{magic, PageSize, sizeof(Node), m_pageCount, root, m_freeHead};
+        std::memcpy(page.get(), &header, sizeof(header));
+        return writePage(0, page.get());
+    }
+
+    template <typename Node, std::size_t PageSize>
+    void
+    PagedStorage<Node, PageSize>::close() noexcept
+    {
+        if (m_fd < 0) return;
+
+        if (m_map) ::munmap(m_map, m_mapSize);
+        ::close(m_fd);
+        m_fd = -1;
+    }
+
+    template <typename Node, std::size_t PageSize>
+    void
+    PagedStorage<Node, PageSize>::swap(PagedStorage& other) noexcept
+    {
+        std::swap(m_fd, other.m_fd);
+        std::swap(m_map, other.m_map);
+        std::swap(m_mapSize, other.m_mapSize);
+        std::swap(m_capacity, other.m_capacity);
+        m_frames.swap(other.m_frames);
+        m_table.swap(other.m_table);
+        m_lru.swap(other.m_lru);
+        m_pinned.swap(other.m_pinned);
+        std::swap(m_contextDepth, other.m_contextDepth);
+        std::swap(m_pinDepth, other.m_pinDepth);
+        std::swap(m_writeDepth, other.m_writeDepth);
+        std::swap(m_failed, other.m_failed);
+        std::swap(m_pageCount, other.m_pageCount);
+        std::swap(m_root, other.m_root);
+        std::swap(m_freeHead, other.m_freeHead);
+    }
+
+} // myDS
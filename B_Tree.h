@@ -2,18 +2,31 @@
 
 #include <iostream>
 #include <vector>
+#include <array>
 #include <memory>
-#include <cmath>
-#include <queue>
-
-template <typename T>
+#include <iterator>
+#include <utility>
+#include <type_traits>
+
+#include "BTree_Storage.h"
+#include "Stats.h"
+
+// MinDegree is the minimum degree t of Cormen, every node but the root has t - 1 to 2t - 1 keys.
+// A node keeps its keys and child links inline in one allocation, Storage decides what a link is
+// (see BTree_Storage.h): by default the node owns its children on the heap, with myDS::PagedStorage
+// the nodes are pages of a file and MinDegree is best taken from myDS::degreeForPage.
+template <typename T, int MinDegree = 16, template <typename> class Storage = myDS::InMemoryStorage>
 class BTree {
+    static_assert(MinDegree >= 2, "a B-tree node splits into two nodes of at least one key");
+
 public:
-    class BTreeNode : public std::enable_shared_from_this<BTreeNode> {
+    class BTreeNode {
         public:
-            BTreeNode(int t, bool isLeaf);
-            void traverse() noexcept;            
-            std::shared_ptr<BTreeNode> search(T key);
+            using Link = typename Storage<BTreeNode>::Link;
+
+            BTreeNode(bool isLeaf);
+            void traverse() const noexcept;
+            BTreeNode* search(T key);
             
             // Inserts a new key in the subtree rooted with this node,
             // The node must be non-full when the function is called.
@@ -22,10 +35,13 @@ public:
             // Splits the child 'y' of this node.
             // 'i' is the index of 'y' in children array.
             // The child 'y' must be full when this function is called.
-            void splitChild(int i, std::shared_ptr<BTreeNode> y);
+            void splitChild(int i, BTreeNode* y);
 
-            // returns the index of the first element >= key
-            int findKey(T key);
+            // returns the index of the first element >= key, a branchless binary search
+            int findKey(const T& key) const;
+
+            // returns the index of the first element > key
+            int findKeyAfter(const T& key) const;
 
             // wrapper function to remove the key in subtree rooted with this node
             void remove(T key);
@@ -60,94 +76,219 @@ public:
             void merge(int index);
 
             void print() const;
+
+            BTreeNode* childAt(int index) const { return Storage<BTreeNode>::get(m_children[index]); }
         public:
-            int m_t; // min degree
-            std::vector<T> m_keys;
-            std::vector<std::shared_ptr<BTreeNode>> m_children;
+            std::array<T, 2 * MinDegree - 1> m_keys; // keys should be one less than the order
+            std::array<Link, 2 * MinDegree> m_children;
             int m_size; // current number of keys
             bool m_isLeaf;
     };
 
+    // In-order iterator over the keys. It keeps the path from the root, every node on it with the
+    // index of the child the path goes down to, and the last node with the index of the current key,
+    // so moving within a node is an index step over its key array. The path holds Refs, which the
+    // iterator gets again on every step, so it keeps no page of a paged storage pinned; the key it
+    // refers to stays valid until the tree is used again.
+    // Any change to the tree invalidates its iterators.
+    class const_iterator {
+        public:
+            using iterator_category = std::bidirectional_iterator_tag;
+            using value_type = T;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const T*;
+            using reference = const T&;
+
+            const_iterator() { }
+
+            reference operator*() const;
+            pointer operator->() const { return &**this; }
+
+            const_iterator& operator++();
+            const_iterator& operator--();
+
+            const_iterator operator++(int) { const_iterator it{*this}; ++*this; return it; }
+            const_iterator operator--(int) { const_iterator it{*this}; --*this; return it; }
+
+            bool operator==(const const_iterator& other) const noexcept { return m_path == other.m_path; }
+
+        private:
+            friend class BTree;
+
+            using Ref = typename Storage<BTreeNode>::Ref;
+
+            const_iterator(const Storage<BTreeNode>* storage, Ref root) : m_storage{storage}, m_root{root} { }
+
+            // goes down to the first key of the subtree rooted with node
+            void descendLeftmost(Ref node);
+
+            // goes down to the last key of the subtree rooted with node
+            void descendRightmost(Ref node);
+
+            // goes up past the nodes whose keys are all visited
+            void skipFinished();
+
+            const Storage<BTreeNode>* m_storage{nullptr};
+            Ref m_root{};
+            std::vector<std::pair<Ref, int>> m_path; // empty at end()
+    };
+
+    // the keys can't be changed in place
+    using iterator = const_iterator;
+
+    using Link = typename BTreeNode::Link;
+    using Store = Storage<BTreeNode>;
+
+    // Scope of one operation on the nodes, see BTree_Storage.h
+    using Context = typename Store::Context;
+
+private:
+    [[no_unique_address]] Store m_storage; // declared first, the root is loaded from it
+
 public:
-    std::shared_ptr<BTreeNode> m_root;
-    int m_t; // min degree
+    Link m_root{};
+    static constexpr int m_t = MinDegree; // min degree
+
+    BTree() { }
+
+    // Opens the tree kept by storage, as of its last checkpoint.
+    explicit BTree(Store storage) : m_storage{std::move(storage)}, m_root{m_storage.loadRoot()} { }
+
+    BTree(BTree&&) = default;
+
+    ~BTree() { checkpoint(); }
+
+    // Writes the changed nodes and the root to the storage, false on an I/O error.
+    bool checkpoint() { return m_storage.checkpoint(m_root); }
+
+    // Node pointers returned by search stay valid while the returned context lives, with a paged storage
+    // they may be evicted from the buffer pool after their operation otherwise.
+    Context pin() const { return Context{m_storage, false}; }
 
-    BTree(int t);
     void traverse() const noexcept;
-    std::shared_ptr<BTreeNode> search(T key);
+
+    // the node holding key, nullptr if there is none
+    BTreeNode* search(T key);
 
     void insert(T key);
     void remove(T key);
 
+    const_iterator begin() const;
+    const_iterator end() const;
+
+    // first key >= key
+    const_iterator lower_bound(T key) const;
+
+    // first key > key
+    const_iterator upper_bound(T key) const;
+
+    // Calls visit(key) for the keys in [lo, hi) in increasing order, reading them straight from the
+    // key arrays of the nodes, O(log n + k) for k keys.
+    // A visitor that returns bool stops the scan by returning false.
+    template <typename Visitor>
+    void rangeScan(T lo, T hi, Visitor&& visit) const;
+
     void print() const noexcept;
+
+private:
+    using Ref = typename Store::Ref;
+
+    // Opened around every step down the tree, a paged storage then keeps only the nodes along the path
+    // of an operation pinned.
+    using Scope = typename Store::Scope;
+
+    // returns false if the visitor has stopped the scan
+    template <typename Visitor>
+    static bool rangeScanHelper(const BTreeNode* node, const T& lo, const T& hi, Visitor& visit);
+
+    // prints the keys of the nodes that are level steps below node, left to right
+    static void printLevel(const BTreeNode* node, int level);
+
+    // iterator to the first key >= key, or to the first key > key if After
+    template <bool After>
+    const_iterator bound(const T& key) const;
+
+    BTreeNode* rootNode() const { return m_root ? Store::get(m_root) : nullptr; }
 };
 
 // *******************   BTree functionality ********************
 
-template <typename T>
-BTree<T>::BTree(int t) : m_root{nullptr}, m_t{t}
-{ }
-
-template <typename T>
+template <typename T, int MinDegree, template <typename> class Storage>
 void
-BTree<T>::traverse() const noexcept
+BTree<T, MinDegree, Storage>::traverse() const noexcept
 {
-    if (m_root != nullptr) {
-        m_root->traverse();
+    Context context{m_storage, false};
+    if (m_root) {
+        rootNode()->traverse();
     }
 }
 
-template <typename T>
+template <typename T, int MinDegree, template <typename> class Storage>
 void
-BTree<T>::print() const noexcept
+BTree<T, MinDegree, Storage>::print() const noexcept
 {
+    Context context{m_storage, false};
     std::cout << "\n\n";
-    std::queue<std::shared_ptr<BTreeNode>> q;
-    if (m_root) q.push(m_root);
-
-    while (!q.empty()) {
-        int size = q.size();
-        while (size--) {
-            auto top = q.front();
-            q.pop();
-            for (int i = 0; i < top->m_size; ++i) std::cout << top->m_keys[i] << " ";
-            std::cout << "\t";
-
-            for (int i = 0; i < top->m_size + 1; ++i) {
-                if (top->m_children[i]) q.push(top->m_children[i]);
-            }
-        }
+    if (!m_root) return;
+
+    // a walk from the root for every level, a queue of the nodes of a level would keep them all in memory
+    int height = 1;
+    {
+        Scope scope;
+        for (const BTreeNode* node = rootNode(); !node->m_isLeaf; node = node->childAt(0)) ++height;
+    }
 
+    for (int level = 0; level < height; ++level) {
+        printLevel(rootNode(), level);
         std::cout << std::endl;
     }
 }
 
-template <typename T>
-std::shared_ptr<typename BTree<T>::BTreeNode>
-BTree<T>::search(T key)
+template <typename T, int MinDegree, template <typename> class Storage>
+void
+BTree<T, MinDegree, Storage>::printLevel(const BTreeNode* node, int level)
+{
+    if (level == 0) {
+        for (int i = 0; i < node->m_size; ++i) std::cout << node->m_keys[i] << " ";
+        std::cout << "\t";
+        return;
+    }
+
+    for (int i = 0; i < node->m_size + 1; ++i) {
+        Scope scope;
+        printLevel(node->childAt(i), level - 1);
+    }
+}
+
+template <typename T, int MinDegree, template <typename> class Storage>
+typename BTree<T, MinDegree, Storage>::BTreeNode*
+BTree<T, MinDegree, Storage>::search(T key)
 {
-    return m_root == nullptr ? nullptr : m_root->search(key);
+    Context context{m_storage, false};
+    return m_root ? rootNode()->search(key) : nullptr;
 }
 
-template <typename T>
+template <typename T, int MinDegree, template <typename> class Storage>
 void
-BTree<T>::insert(T key)
+BTree<T, MinDegree, Storage>::insert(T key)
 {
-    if (m_root == nullptr) {
-        m_root = std::make_shared<BTreeNode>(m_t, true);
-        m_root->m_keys[0] = key;
-        m_root->m_size = 1;
+    Context context{m_storage, true};
+    if (!m_root) {
+        m_root = Store::create(true);
+        BTreeNode* root = rootNode();
+        root->m_keys[0] = key;
+        root->m_size = 1;
     } else {
-        if (m_root->m_size == m_t * 2 - 1) {
+        if (rootNode()->m_size == m_t * 2 - 1) {
             // creating a new root
-            std::shared_ptr<BTreeNode> node =
-                std::make_shared<BTreeNode>(m_t, false);
+            Link newRoot = Store::create(false);
+            BTreeNode* node = Store::get(newRoot);
 
             // making the old root as a child of the new node
-            node->m_children[0] = m_root;
+            node->m_children[0] = std::move(m_root);
 
             // split the old root and move 1 key to the new root
-            node->splitChild(0, m_root);
+            node->splitChild(0, node->childAt(0));
 
             // new root has two children now.
             // decide which of the two children is going to have the new key
@@ -155,95 +296,285 @@ BTree<T>::insert(T key)
             if (node->m_keys[0] < key) {
                 ++i;
             }
-            node->m_children[i]->insertNonFull(key);
-            m_root = node;
+            node->childAt(i)->insertNonFull(key);
+            m_root = std::move(newRoot);
         } else {
-            m_root->insertNonFull(key);
+            rootNode()->insertNonFull(key);
         }
     }
 }
 
-template <typename T>
+template <typename T, int MinDegree, template <typename> class Storage>
 void
-BTree<T>::remove(T key)
+BTree<T, MinDegree, Storage>::remove(T key)
 {
     if (!m_root) return;
 
-    m_root->remove(key);
+    Context context{m_storage, true};
+    BTreeNode* root = rootNode();
+    root->remove(key);
 
     // If after the remove the root has no keys
     // make his first child as the new root
     // if it has no children, set the root null
 
-    if (m_root->m_size == 0) {
-        if (m_root->m_isLeaf) {
-            m_root = nullptr;
+    if (root->m_size == 0) {
+        Link oldRoot = std::exchange(m_root, Link{});
+        if (!root->m_isLeaf) {
+            m_root = std::move(root->m_children[0]);
+        }
+        Store::destroy(oldRoot);
+    }
+}
+
+
+template <typename T, int MinDegree, template <typename> class Storage>
+typename BTree<T, MinDegree, Storage>::const_iterator
+BTree<T, MinDegree, Storage>::begin() const
+{
+    Context context{m_storage, false};
+    Scope scope;
+    const_iterator it{&m_storage, Store::ref(m_root)};
+    if (m_root) it.descendLeftmost(Store::ref(m_root));
+    return it;
+}
+
+template <typename T, int MinDegree, template <typename> class Storage>
+typename BTree<T, MinDegree, Storage>::const_iterator
+BTree<T, MinDegree, Storage>::end() const
+{
+    return const_iterator{&m_storage, Store::ref(m_root)};
+}
+
+template <typename T, int MinDegree, template <typename> class Storage>
+typename BTree<T, MinDegree, Storage>::const_iterator
+BTree<T, MinDegree, Storage>::lower_bound(T key) const
+{
+    return bound<false>(key);
+}
+
+template <typename T, int MinDegree, template <typename> class Storage>
+typename BTree<T, MinDegree, Storage>::const_iterator
+BTree<T, MinDegree, Storage>::upper_bound(T key) const
+{
+    return bound<true>(key);
+}
+
+template <typename T, int MinDegree, template <typename> class Storage>
+template <bool After>
+typename BTree<T, MinDegree, Storage>::const_iterator
+BTree<T, MinDegree, Storage>::bound(const T& key) const
+{
+    Context context{m_storage, false};
+    Scope scope;
+    const_iterator it{&m_storage, Store::ref(m_root)};
+    Ref ref = Store::ref(m_root);
+    while (ref) {
+        const BTreeNode* node = Store::get(ref);
+        int index = After ? node->findKeyAfter(key) : node->findKey(key);
+        it.m_path.push_back({ref, index});
+
+        // equal keys may also sit in the child on the left of m_keys[index]
+        ref = node->m_isLeaf ? Ref{} : Store::ref(node->m_children[index]);
+    }
+
+    it.skipFinished();
+    return it;
+}
+
+template <typename T, int MinDegree, template <typename> class Storage>
+template <typename Visitor>
+void
+BTree<T, MinDegree, Storage>::rangeScan(T lo, T hi, Visitor&& visit) const
+{
+    Context context{m_storage, false};
+    if (m_root) rangeScanHelper(rootNode(), lo, hi, visit);
+}
+
+template <typename T, int MinDegree, template <typename> class Storage>
+template <typename Visitor>
+bool
+BTree<T, MinDegree, Storage>::rangeScanHelper(const BTreeNode* node, const T& lo, const T& hi, Visitor& visit)
+{
+    // the children left of the first key >= lo hold only smaller keys
+    int i = node->findKey(lo);
+    for (; i < node->m_size; ++i) {
+        if (!node->m_isLeaf) {
+            Scope scope;
+            if (!rangeScanHelper(node->childAt(i), lo, hi, visit)) return false;
+        }
+
+        // all keys from here on are >= hi
+        if (!(node->m_keys[i] < hi)) return false;
+
+        if constexpr (std::is_same_v<std::invoke_result_t<Visitor&, const T&>, bool>) {
+            if (!visit(node->m_keys[i])) return false;
         } else {
-            m_root = m_root->m_children[0];
+            visit(node->m_keys[i]);
         }
     }
+
+    if (node->m_isLeaf) return true;
+
+    Scope scope;
+    return rangeScanHelper(node->childAt(i), lo, hi, visit);
 }
 
+// ***************************    const_iterator functionality  *****************************
 
-// ***************************    BTreeNode functionality  *****************************
+template <typename T, int MinDegree, template <typename> class Storage>
+typename BTree<T, MinDegree, Storage>::const_iterator::reference
+BTree<T, MinDegree, Storage>::const_iterator::operator*() const
+{
+    Context context{*m_storage, false};
+    Scope scope;
+    return Store::get(m_path.back().first)->m_keys[m_path.back().second];
+}
+
+template <typename T, int MinDegree, template <typename> class Storage>
+void
+BTree<T, MinDegree, Storage>::const_iterator::descendLeftmost(Ref ref)
+{
+    const BTreeNode* node = Store::get(ref);
+    while (!node->m_isLeaf) {
+        m_path.push_back({ref, 0});
+        ref = Store::ref(node->m_children[0]);
+        node = Store::get(ref);
+    }
+    m_path.push_back({ref, 0});
+}
+
+template <typename T, int MinDegree, template <typename> class Storage>
+void
+BTree<T, MinDegree, Storage>::const_iterator::descendRightmost(Ref ref)
+{
+    const BTreeNode* node = Store::get(ref);
+    while (!node->m_isLeaf) {
+        m_path.push_back({ref, node->m_size});
+        ref = Store::ref(node->m_children[node->m_size]);
+        node = Store::get(ref);
+    }
+    m_path.push_back({ref, node->m_size - 1});
+}
+
+template <typename T, int MinDegree, template <typename> class Storage>
+void
+BTree<T, MinDegree, Storage>::const_iterator::skipFinished()
+{
+    // a node on the path that has been left through its child i continues with its key i
+    while (!m_path.empty() && m_path.back().second == Store::get(m_path.back().first)->m_size) {
+        m_path.pop_back();
+    }
+}
 
-template <typename T>
-BTree<T>::BTreeNode::BTreeNode(int t, bool isLeaf)
-    : m_t{t}, m_isLeaf{isLeaf}, m_size{}
+template <typename T, int MinDegree, template <typename> class Storage>
+typename BTree<T, MinDegree, Storage>::const_iterator&
+BTree<T, MinDegree, Storage>::const_iterator::operator++()
 {
-    m_keys.resize(2 * m_t - 1); // keys should be one less than the order
-    m_children.resize(2 * m_t);
+    Context context{*m_storage, false};
+    Scope scope;
+    auto& [ref, index] = m_path.back();
+    const BTreeNode* node = Store::get(ref);
+    if (!node->m_isLeaf) {
+        // the next key is the first one of the child right of the current key
+        descendLeftmost(Store::ref(node->m_children[++index]));
+        return *this;
+    }
+
+    ++index;
+    skipFinished();
+    return *this;
 }
 
-template <typename T>
+template <typename T, int MinDegree, template <typename> class Storage>
+typename BTree<T, MinDegree, Storage>::const_iterator&
+BTree<T, MinDegree, Storage>::const_iterator::operator--()
+{
+    Context context{*m_storage, false};
+    Scope scope;
+    if (m_path.empty()) {
+        descendRightmost(m_root);
+        return *this;
+    }
+
+    auto& [ref, index] = m_path.back();
+    const BTreeNode* node = Store::get(ref);
+    if (!node->m_isLeaf) {
+        // the previous key is the last one of the child left of the current key
+        descendRightmost(Store::ref(node->m_children[index]));
+        return *this;
+    }
+
+    if (index > 0) {
+        --index;
+        return *this;
+    }
+
+    // a node on the path that has been left through its child i continues with its key i - 1
+    m_path.pop_back();
+    while (!m_path.empty() && m_path.back().second == 0) {
+        m_path.pop_back();
+    }
+    if (!m_path.empty()) --m_path.back().second;
+
+    return *this;
+}
+
+// ***************************    BTreeNode functionality  *****************************
+
+template <typename T, int MinDegree, template <typename> class Storage>
+BTree<T, MinDegree, Storage>::BTreeNode::BTreeNode(bool isLeaf)
+    : m_keys{}, m_children{}, m_size{}, m_isLeaf{isLeaf}
+{ }
+
+template <typename T, int MinDegree, template <typename> class Storage>
 void
-BTree<T>::BTreeNode::traverse() noexcept
+BTree<T, MinDegree, Storage>::BTreeNode::traverse() const noexcept
 {
     int i = 0;
     for (; i < m_size; ++i) {
         if (m_isLeaf == false) {
-            m_children[i]->traverse();
+            Scope scope;
+            childAt(i)->traverse();
         }
         std::cout << " " << m_keys[i];
     }
 
     // printing the leaf child
     if (m_isLeaf == false) {
-        m_children[i]->traverse();
+        Scope scope;
+        childAt(i)->traverse();
     }
 }
 
-template <typename T>
+template <typename T, int MinDegree, template <typename> class Storage>
 void
-BTree<T>::BTreeNode::print() const
+BTree<T, MinDegree, Storage>::BTreeNode::print() const
 {
     for (int i = 0; i < m_size; ++i) std::cout << m_keys[i] << " ";
     std::cout << std::endl;
 }
 
-template <typename T>
-std::shared_ptr<typename BTree<T>::BTreeNode>
-BTree<T>::BTreeNode::search(T key)
+template <typename T, int MinDegree, template <typename> class Storage>
+typename BTree<T, MinDegree, Storage>::BTreeNode*
+BTree<T, MinDegree, Storage>::BTreeNode::search(T key)
 {
-    int i = 0;
-    while (i < m_size && key > m_keys[i]) {
-        ++i;
-    }
+    int i = findKey(key);
 
-    if (m_keys[i] == key) {
-        return this->shared_from_this();
+    if (i < m_size && m_keys[i] == key) {
+        return this;
     }
 
     if (m_isLeaf == true) {
         return nullptr;
     }
 
-    return m_children[i]->search(key);
+    return childAt(i)->search(key);
 }
 
-template <typename T>
+template <typename T, int MinDegree, template <typename> class Storage>
 void
-BTree<T>::BTreeNode::insertNonFull(T key)
+BTree<T, MinDegree, Storage>::BTreeNode::insertNonFull(T key)
 {
     int i = m_size - 1;
     if (m_isLeaf == true) {
@@ -256,29 +587,29 @@ BTree<T>::BTreeNode::insertNonFull(T key)
         m_keys[i + 1] = key;
         ++m_size;
     } else {
-        while (i >= 0 && m_keys[i] > key) {
-            --i;
-        }
-
+        i = findKeyAfter(key) - 1;
 
         // find the child which is going to have the new key
-        if (m_children[i + 1]->m_size == 2 * m_t - 1) {
-            splitChild(i + 1, m_children[i + 1]); // solves the problem of overflow
+        if (childAt(i + 1)->m_size == 2 * m_t - 1) {
+            splitChild(i + 1, childAt(i + 1)); // solves the problem of overflow
 
             // as after the split the middle key of m_children[i] goes up
             // and children[i] is splitted into two.
             if (m_keys[i + 1] < key) ++i;
         }
 
-        m_children[i + 1]->insertNonFull(key);
+        Scope scope;
+        childAt(i + 1)->insertNonFull(key);
     }
 }
 
-template <typename T>
+template <typename T, int MinDegree, template <typename> class Storage>
 void
-BTree<T>::BTreeNode::splitChild(int index, std::shared_ptr<BTreeNode> y)
+BTree<T, MinDegree, Storage>::BTreeNode::splitChild(int index, BTreeNode* y)
 {
-    std::shared_ptr<BTreeNode> z = std::make_shared<BTreeNode>(y->m_t, y->m_isLeaf);
+    myDS::stats::count(myDS::stats::nodeSplits);
+    Link zLink = Store::create(y->m_isLeaf);
+    BTreeNode* z = Store::get(zLink);
     z->m_size = m_t - 1;
 
     // copy the last (t - 1) keys of y to z
@@ -289,7 +620,7 @@ BTree<T>::BTreeNode::splitChild(int index, std::shared_ptr<BTreeNode> y)
     // copy the last t children of y to z
     if (y->m_isLeaf == false) {
         for (int i = 0; i < m_t; ++i) {
-            z->m_children[i] = y->m_children[i + m_t];
+            z->m_children[i] = std::move(y->m_children[i + m_t]);
         }
     }
 
@@ -299,11 +630,11 @@ BTree<T>::BTreeNode::splitChild(int index, std::shared_ptr<BTreeNode> y)
     // since 'this' node is going to have a new child
     // we need a space for that
     for (int i = m_size; i > index; --i) {
-        m_children[i + 1] = m_children[i];
+        m_children[i + 1] = std::move(m_children[i]);
     }
 
-    m_children[index + 1] = z;
-    for (int i = int(m_size); i >= int(index); --i) {
+    m_children[index + 1] = std::move(zLink);
+    for (int i = m_size - 1; i >= index; --i) {
         m_keys[i + 1] = m_keys[i];
     }
 
@@ -312,21 +643,44 @@ BTree<T>::BTreeNode::splitChild(int index, std::shared_ptr<BTreeNode> y)
     ++m_size;
 }
 
-template <typename T>
+template <typename T, int MinDegree, template <typename> class Storage>
 int
-BTree<T>::BTreeNode::findKey(T key)
+BTree<T, MinDegree, Storage>::BTreeNode::findKey(const T& key) const
 {
-    int index = 0;
-    while (index < m_size && m_keys[index] < key) {
-        ++index;
+    if (m_size == 0) return 0;
+
+    // halving the range without a branch on the comparison, which compiles to a conditional move
+    const T* base = m_keys.data();
+    int size = m_size;
+    while (size > 1) {
+        int half = size / 2;
+        base = base[half] < key ? base + half : base;
+        size -= half;
     }
 
-    return index;
+    return int(base - m_keys.data()) + (*base < key);
 }
 
-template <typename T>
+template <typename T, int MinDegree, template <typename> class Storage>
+int
+BTree<T, MinDegree, Storage>::BTreeNode::findKeyAfter(const T& key) const
+{
+    if (m_size == 0) return 0;
+
+    const T* base = m_keys.data();
+    int size = m_size;
+    while (size > 1) {
+        int half = size / 2;
+        base = !(key < base[half]) ? base + half : base;
+        size -= half;
+    }
+
+    return int(base - m_keys.data()) + !(key < *base);
+}
+
+template <typename T, int MinDegree, template <typename> class Storage>
 void
-BTree<T>::BTreeNode::remove(T key)
+BTree<T, MinDegree, Storage>::BTreeNode::remove(T key)
 {
     int index = findKey(key);
     // the key to be removed is in this node
@@ -350,25 +704,26 @@ BTree<T>::BTreeNode::remove(T key)
         // If the child where the key is supposed to exist has less than t keys, then we fill the child.
         // This is done because if the key exists in the m_children[index] node, 
         // and we remove from that node, we end up with a node which has ( < t - 1) keys
-        if (m_children[index]->m_size < m_t) {
+        if (childAt(index)->m_size < m_t) {
             fill(index); // solves the problem of underflow
         }
 
         // if the LAST child has been merged(flag), it must have been merged with the previous 
         // child and so we recurse on the [index - 1]-th child. 
         // Else we recurse on the [index]-th child which now has at least t keys, as we've already filled it
+        Scope scope;
         if (flag && index > m_size) { // (index == m_size) means whether the key present in the subtree rooted with the last child of this node
-            m_children[index - 1]->remove(key);
+            childAt(index - 1)->remove(key);
         } else {
-            m_children[index]->remove(key);
+            childAt(index)->remove(key);
         }
     }
 }
 
 /* CORMEN - Case 1: The search arrives at a leaf node x. */
-template <typename T>
+template <typename T, int MinDegree, template <typename> class Storage>
 void
-BTree<T>::BTreeNode::removeFromLeaf(int index)
+BTree<T, MinDegree, Storage>::BTreeNode::removeFromLeaf(int index)
 {
     // Moving all keys after the index-th position one place backward
     for (int i = index + 1; i < m_size; ++i) {
@@ -379,9 +734,9 @@ BTree<T>::BTreeNode::removeFromLeaf(int index)
 }
 
 /* Cormen - Case 2: The search arrives at an internal node x that contains the key. */
-template <typename T>
+template <typename T, int MinDegree, template <typename> class Storage>
 void
-BTree<T>::BTreeNode::removeFromNonLeaf(int index)
+BTree<T, MinDegree, Storage>::BTreeNode::removeFromNonLeaf(int index)
 {
     T key = m_keys[index];
 
@@ -390,10 +745,11 @@ BTree<T>::BTreeNode::removeFromNonLeaf(int index)
     // Replace key by predecessor and recursively delete the predecessor in m_children[index]
     
     /* Cormen - Case 2.a: x.c[i] has at least t keys */
-    if (m_children[index]->m_size >= m_t) {
+    if (childAt(index)->m_size >= m_t) {
         T predecessor = getPredecessor(index);
         m_keys[index] = predecessor;
-        m_children[index]->remove(predecessor);
+        Scope scope;
+        childAt(index)->remove(predecessor);
     }
 
     // If the child m_children[index] has less than k keys, examine m_children[index + 1]
@@ -402,10 +758,11 @@ BTree<T>::BTreeNode::removeFromNonLeaf(int index)
     // Replace key by successor and recursively delete successor in m_chilren[index + 1].
 
     /* Cormen - Case 2.b: x.c[i] has t - 1 keys and x.c[i + 1] has at least t keys */
-    else if (m_children[index + 1]->m_size >= m_t) {
+    else if (childAt(index + 1)->m_size >= m_t) {
         T successor = getSuccessor(index);
         m_keys[index] = successor;
-        m_children[index + 1]->remove(successor);
+        Scope scope;
+        childAt(index + 1)->remove(successor);
     }
     
     // If both m_children[index] and m_children[index + 1] have less than t keys,
@@ -416,51 +773,54 @@ BTree<T>::BTreeNode::removeFromNonLeaf(int index)
     /* Cormen - Case 2.c: x.c[i] and x.c[i + 1] have t - 1 keys */
     else {
         merge(index);
-        m_children[index]->remove(key);
+        Scope scope;
+        childAt(index)->remove(key);
     }
 }
 
-template <typename T>
+template <typename T, int MinDegree, template <typename> class Storage>
 T
-BTree<T>::BTreeNode::getPredecessor(int index)
+BTree<T, MinDegree, Storage>::BTreeNode::getPredecessor(int index)
 {
-    std::shared_ptr<BTreeNode> curr = m_children[index];
+    Scope scope;
+    const BTreeNode* curr = childAt(index);
     while (!curr->m_isLeaf) {
-        curr = curr->m_children[m_size];
+        curr = curr->childAt(curr->m_size);
     }
 
     return curr->m_keys[curr->m_size - 1];
 }
 
-template <typename T>
+template <typename T, int MinDegree, template <typename> class Storage>
 T
-BTree<T>::BTreeNode::getSuccessor(int index)
+BTree<T, MinDegree, Storage>::BTreeNode::getSuccessor(int index)
 {
-    std::shared_ptr<BTreeNode> curr = m_children[index + 1];
+    Scope scope;
+    const BTreeNode* curr = childAt(index + 1);
     while (!curr->m_isLeaf) {
-        curr = curr->m_children[0];
+        curr = curr->childAt(0);
     }
 
     return curr->m_keys[0];
 }
 
 /* Cormen - Case 3 ... */
-template <typename T>
+template <typename T, int MinDegree, template <typename> class Storage>
 void
-BTree<T>::BTreeNode::fill(int index)
+BTree<T, MinDegree, Storage>::BTreeNode::fill(int index)
 {
     // if the previous child (m_children[index - 1]) has more than t - 1 keys
     // borrow a key from that child
 
     /* Cormen - Case 3.a: x.c[i] has only t - 1 keys but has an immediate sibling with at least t keys */
-    if (index != 0 && m_children[index - 1]->m_size >= m_t) {
+    if (index != 0 && childAt(index - 1)->m_size >= m_t) {
         borrowFromPrev(index);
     }
     // if the next child (m_children[index + 1]) has more than t - 1 keys
     // borrow a key from that child
 
     /* Cormen - Case 3.a: the same as above */
-    else if (index != m_size && m_children[index + 1]->m_size >= m_t) {
+    else if (index != m_size && childAt(index + 1)->m_size >= m_t) {
         borrowFromNext(index);
     }
 
@@ -478,12 +838,12 @@ BTree<T>::BTreeNode::fill(int index)
     }
 }
 
-template <typename T>
+template <typename T, int MinDegree, template <typename> class Storage>
 void
-BTree<T>::BTreeNode::borrowFromPrev(int index)
+BTree<T, MinDegree, Storage>::BTreeNode::borrowFromPrev(int index)
 {
-    std::shared_ptr<BTreeNode>& child = m_children[index];
-    std::shared_ptr<BTreeNode>& sibling = m_children[index - 1];
+    BTreeNode* child = childAt(index);
+    BTreeNode* sibling = childAt(index - 1);
 
     // The last key from m_children[index - 1] goes up to the parent 
     // and m_keys[index - 1] from parent is inserted as the first key in m_children[index].
@@ -497,7 +857,7 @@ BTree<T>::BTreeNode::borrowFromPrev(int index)
     // If the m_children[index] is not a leaf, move all its child pointers one step ahead
     if (!child->m_isLeaf) {
         for (int i = child->m_size; i >= 0; --i) {
-            child->m_children[i + 1] = child->m_children[i];
+            child->m_children[i + 1] = std::move(child->m_children[i]);
         }
     }
     
@@ -506,7 +866,7 @@ BTree<T>::BTreeNode::borrowFromPrev(int index)
 
     // Move sibling's last child as m_children[index]'s first child
     if (!child->m_isLeaf) {
-        child->m_children[0] = sibling->m_children[sibling->m_size];
+        child->m_children[0] = std::move(sibling->m_children[sibling->m_size]);
     }
 
     // Move the key from the sibling to the parent 
@@ -517,19 +877,19 @@ BTree<T>::BTreeNode::borrowFromPrev(int index)
     --sibling->m_size;
 }
 
-template <typename T>
+template <typename T, int MinDegree, template <typename> class Storage>
 void
-BTree<T>::BTreeNode::borrowFromNext(int index)
+BTree<T, MinDegree, Storage>::BTreeNode::borrowFromNext(int index)
 {
-    std::shared_ptr<BTreeNode>& child = m_children[index];
-    std::shared_ptr<BTreeNode>& sibling = m_children[index + 1];
+    BTreeNode* child = childAt(index);
+    BTreeNode* sibling = childAt(index + 1);
 
     // m_keys[index] is inserted as the last key in m_children[index]
     child->m_keys[child->m_size] = m_keys[index];
 
     // Sibling's first child is inserted as a last child into m_children[index]
     if (!child->m_isLeaf) {
-        child->m_children[child->m_size + 1] = sibling->m_children[0];
+        child->m_children[child->m_size + 1] = std::move(sibling->m_children[0]);
     }
 
     // The first key from sibling is inserted into m_keys[index]
@@ -543,7 +903,7 @@ BTree<T>::BTreeNode::borrowFromNext(int index)
     // Moving the child pointers one step behind
     if (!sibling->m_isLeaf) {
         for (int i = 1; i <= sibling->m_size; ++i) {
-            sibling->m_children[i - 1] = sibling->m_children[i];
+            sibling->m_children[i - 1] = std::move(sibling->m_children[i]);
         }
     }
 
@@ -552,12 +912,14 @@ BTree<T>::BTreeNode::borrowFromNext(int index)
     --sibling->m_size;
 }
 
-template <typename T>
+template <typename T, int MinDegree, template <typename> class Storage>
 void 
-BTree<T>::BTreeNode::merge(int index) 
+BTree<T, MinDegree, Storage>::BTreeNode::merge(int index) 
 {
-    std::shared_ptr<BTreeNode>& child = m_children[index];
-    std::shared_ptr<BTreeNode>& sibling = m_children[index + 1];
+    BTreeNode* child = childAt(index);
+    // the sibling is freed at the end
+    Link siblingLink = std::exchange(m_children[index + 1], Link{});
+    BTreeNode* sibling = Store::get(siblingLink);
 
     // Pull a key from this node and insert it into [t - 1]-th pos of m_children[index]
     child->m_keys[m_t - 1] = m_keys[index];
@@ -570,7 +932,7 @@ BTree<T>::BTreeNode::merge(int index)
     // Copy the child pointers
     if (!child->m_isLeaf) {
         for (int i = 0; i <= sibling->m_size; ++i) {
-            child->m_children[m_t + i] = sibling->m_children[i];
+            child->m_children[m_t + i] = std::move(sibling->m_children[i]);
         }
     }
 
@@ -583,10 +945,12 @@ BTree<T>::BTreeNode::merge(int index)
     // The same for the children pointers after [index + 1] in this node one step back
     // no need to check if this node is a leaf, as it is impossible
     for (int i = index + 2; i <= m_size; ++i) {
-        m_children[i - 1] = m_children[i];
+        m_children[i - 1] = std::move(m_children[i]);
     }
 
     // So the child took one key from its parent(from this) and all keys from its sibling
     child->m_size += sibling->m_size + 1;
     --m_size;
+
+    Store::destroy(siblingLink);
 }
@@ -0,0 +1,196 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace myDS {
+
+    /*
+    * Node allocators for the trees. An allocator hands out and takes back single objects:
+    *   create(args...)  constructs a T and returns a pointer to it
+    *   destroy(p)       destroys *p and takes the memory back
+    *   merge(other)     takes over everything other owns, after that other owns nothing
+    *   share()          returns a new allocator that can destroy the objects this one created,
+    *                    so that a tree can hand a part of itself to another tree
+    * and says with releasesInBulk whether its destructor frees all of its memory at once, in which
+    * case a tree with trivially destructible nodes doesn't have to visit every node when destroyed.
+    */
+
+    // Slab allocator with a free list. Slabs grow geometrically up to maxSlabSize objects, destroyed
+    // objects are recycled by later create calls, and the slabs are freed together with the pool.
+    // Pools made by share() co-own the slabs, which are freed with the last pool that owns them.
+    // share() and merge() take O(1), so trees can hand nodes to each other in their join and split.
+    template <typename T>
+    class NodePool {
+    public:
+        static constexpr bool releasesInBulk{ true };
+
+        NodePool() { }
+
+        NodePool(const NodePool&) = delete;
+        NodePool& operator=(const NodePool&) = delete;
+
+        NodePool(NodePool&& other) { merge(other); }
+
+        NodePool& operator=(NodePool&& other) {
+            if (this != &other) {
+                release();
+                m_free = m_freeTail = nullptr;
+                m_slabSize = minSlabSize;
+                merge(other);
+            }
+            return *this;
+        }
+
+        ~NodePool() { release(); }
+
+        template <typename... Args>
+        T* create(Args&&... args) {
+            if (!m_free) grow();
+
+            // the first slot of the first free run is taken, the rest of the run starts one slot later
+            Slot* slot{ m_free };
+            if (slot->run.end == slot + 1) {
+                m_free = slot->run.next;
+                if (!m_free) m_freeTail = nullptr;
+            }
+            else {
+                Slot* rest{ slot + 1 };
+                rest->run = slot->run;
+                m_free = rest;
+                if (m_freeTail == slot) m_freeTail = rest;
+            }
+
+            return ::new (static_cast<void*>(slot->storage)) T(std::forward<Args>(args)...);
+        }
+
+        void destroy(T* p) noexcept {
+            p->~T();
+            Slot* slot{ reinterpret_cast<Slot*>(p) };
+            pushRun(slot, slot + 1);
+        }
+
+        // Returns an empty pool that co-owns the slabs of this one.
+        NodePool share() const {
+            NodePool pool;
+            pool.m_slabs = m_slabs;
+            return pool;
+        }
+
+        // Takes over the slabs of other, the objects it handed out now belong to this pool.
+        void merge(NodePool& other) {
+            if (this == &other) return;
+
+            // one node over both slab sets, pools that were shared and merged back reach some slabs twice
+            if (!m_slabs) {
+                m_slabs = std::move(other.m_slabs);
+            }
+            else if (other.m_slabs) {
+                auto node{ std::make_shared<SlabNode>() };
+                node->first = std::move(m_slabs);
+                node->second = std::move(other.m_slabs);
+                m_slabs = std::move(node);
+            }
+
+            // the free runs of other go after ours
+            if (other.m_free) {
+                if (m_freeTail) m_freeTail->run.next = other.m_free;
+                else m_free = other.m_free;
+                m_freeTail = other.m_freeTail;
+            }
+
+            other.m_slabs.reset();
+            other.m_free = other.m_freeTail = nullptr;
+            other.m_slabSize = minSlabSize;
+        }
+
+    private:
+        union Slot;
+
+        // a free run is the slots [this, end), the runs are linked through next
+        struct Run {
+            Slot* next;
+            Slot* end;
+        };
+
+        union Slot {
+            Run run;
+            alignas(T) unsigned char storage[sizeof(T)];
+        };
+
+        // The slabs are owned through an immutable graph: grow() puts a node with the new slab in front of the
+        // pool's node, merge() makes a node over the nodes of both pools and share() copies the pool's node.
+        struct SlabNode {
+            std::unique_ptr<Slot[]> slab;
+            std::shared_ptr<SlabNode> first;
+            std::shared_ptr<SlabNode> second;
+        };
+
+        static constexpr std::size_t minSlabSize{ 64 };
+        static constexpr std::size_t maxSlabSize{ 4096 };
+
+        void pushRun(Slot* begin, Slot* end) noexcept {
+            begin->run = Run{ m_free, end };
+            if (!m_free) m_freeTail = begin;
+            m_free = begin;
+        }
+
+        void grow() {
+            auto node{ std::make_shared<SlabNode>() };
+            node->slab.reset(new Slot[m_slabSize]);
+            node->first = std::move(m_slabs);
+            Slot* slab{ node->slab.get() };
+            m_slabs = std::move(node);
+
+            pushRun(slab, slab + m_slabSize);
+            m_slabSize = std::min(2 * m_slabSize, maxSlabSize);
+        }
+
+        // Drops the pool's node without recursing down a long chain of slabs and merges. The nodes nobody
+        // else owns are taken apart here, the shared ones are freed by their last owner.
+        void release() {
+            std::vector<std::shared_ptr<SlabNode>> stack;
+            if (m_slabs) stack.push_back(std::move(m_slabs));
+
+            while (!stack.empty()) {
+                std::shared_ptr<SlabNode> node{ std::move(stack.back()) };
+                stack.pop_back();
+                if (node.use_count() == 1) {
+                    if (node->first) stack.push_back(std::move(node->first));
+                    if (node->second) stack.push_back(std::move(node->second));
+                }
+            }
+        }
+
+    private:
+        std::shared_ptr<SlabNode> m_slabs;
+        Slot* m_free{ nullptr };     // free runs, linked through Run::next
+        Slot* m_freeTail{ nullptr }; // last free run, merge appends other's runs after it
+        std::size_t m_slabSize{ minSlabSize }; // size of the next slab
+    };
+
+    // Plain new and delete, for comparison or when nodes must be freed back to the heap right away.
+    template <typename T>
+    class HeapAllocator {
+    public:
+        static constexpr bool releasesInBulk{ false };
+
+        template <typename... Args>
+        T* create(Args&&... args) {
+            return new T(std::forward<Args>(args)...);
+        }
+
+        void destroy(T* p) noexcept {
+            delete p;
+        }
+
+        void merge(HeapAllocator&) noexcept { }
+
+        HeapAllocator share() const noexcept { return {}; }
+    };
+
+} // myDS
@@ -2,10 +2,29 @@
 
 #include <iostream>
 #include <queue>
+#include <iterator>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <cstddef>
+#include <optional>
+#include <vector>
+#include <future>
+#include <thread>
+#include <bit>
+#include <algorithm>
+
+#include "Node_Pool.h"
+#include "Tree_Augment.h"
+#include "Stats.h"
 
 namespace myDS {
 
-template <typename T>
+// Nodes come from Alloc<Node>, by default a NodePool that recycles the nodes of removed values.
+// Every node caches its subtree size and the Augment aggregate of its subtree (see Tree_Augment.h),
+// which gives O(log n) select, rank, countInRange and rangeAggregate. Tnil has size 0 and the identity.
+// All trees of an instantiation share one Tnil that is never written, so nodes can move between trees.
+template <typename T, template <typename> class Alloc = NodePool, typename Augment = NoAggregate<T>>
 class RBT {
     enum class COLOR { RED, BLACK };
     struct Node {
@@ -14,15 +33,165 @@ class RBT {
         Node* left{ nullptr };
         Node* right{ nullptr };
         Node* parent{ nullptr };
+        std::size_t m_size{ 1 };
+        [[no_unique_address]] typename Augment::value_type m_agg;
 
-        Node(T val): m_val(val), m_color{COLOR::RED}, left{nullptr}, right{nullptr}, parent{nullptr} { } 
+        Node(T val): m_val(val), m_color{COLOR::RED}, left{nullptr}, right{nullptr}, parent{nullptr}, m_agg{ Augment::lift(m_val) } { } 
     };
 
 public:
-    RBT() {
-        Tnil = new Node(T{});
-        Tnil->m_color = COLOR::BLACK;
-        root = Tnil;
+    // Owns a node taken out of the tree by extract(), insert() puts it back without allocating.
+    // A handle must not outlive the tree it came from.
+    class NodeHandle {
+    public:
+        NodeHandle() { }
+
+        NodeHandle(NodeHandle&& other) noexcept : m_node{ std::exchange(other.m_node, nullptr) }, m_alloc{ other.m_alloc } { }
+
+        NodeHandle& operator=(NodeHandle&& other) noexcept {
+            if (this != &other) {
+                reset();
+                m_node = std::exchange(other.m_node, nullptr);
+                m_alloc = other.m_alloc;
+            }
+            return *this;
+        }
+
+        ~NodeHandle() { reset(); }
+
+        bool empty() const noexcept { return !m_node; }
+        explicit operator bool() const noexcept { return m_node; }
+
+        // the value may be changed before the node is inserted again
+        T& value() const noexcept { return m_node->m_val; }
+
+    private:
+        friend class RBT;
+
+        NodeHandle(Node* node, Alloc<Node>* alloc) : m_node{ node }, m_alloc{ alloc } { }
+
+        void reset() noexcept {
+            if (m_node) m_alloc->destroy(m_node);
+            m_node = nullptr;
+        }
+
+        Node* m_node{ nullptr };
+        Alloc<Node>* m_alloc{ nullptr };
+    };
+
+    // In-order iterator over the values, steps through the parent links. Any change to the tree
+    // invalidates its iterators.
+    class const_iterator {
+    public:
+        using iterator_category = std::bidirectional_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const T*;
+        using reference = const T&;
+
+        const_iterator() { }
+
+        reference operator*() const noexcept { return m_node->m_val; }
+        pointer operator->() const noexcept { return &m_node->m_val; }
+
+        const_iterator& operator++() noexcept {
+            const Node* nil{ m_tree->Tnil };
+            if (m_node->right != nil) {
+                m_node = m_node->right;
+                while (m_node->left != nil) m_node = m_node->left;
+                return *this;
+            }
+
+            // the first ancestor reached from its left subtree, Tnil past the root
+            const Node* parent{ m_node->parent };
+            while (parent != nil && m_node == parent->right) {
+                m_node = parent;
+                parent = parent->parent;
+            }
+            m_node = parent;
+            return *this;
+        }
+
+        const_iterator& operator--() noexcept {
+            const Node* nil{ m_tree->Tnil };
+            if (m_node == nil) {
+                m_node = m_tree->root;
+                while (m_node->right != nil) m_node = m_node->right;
+                return *this;
+            }
+
+            if (m_node->left != nil) {
+                m_node = m_node->left;
+                while (m_node->right != nil) m_node = m_node->right;
+                return *this;
+            }
+
+            const Node* parent{ m_node->parent };
+            while (parent != nil && m_node == parent->left) {
+                m_node = parent;
+                parent = parent->parent;
+            }
+            m_node = parent;
+            return *this;
+        }
+
+        const_iterator operator++(int) noexcept {
+            const_iterator it{ *this };
+            ++*this;
+            return it;
+        }
+
+        const_iterator operator--(int) noexcept {
+            const_iterator it{ *this };
+            --*this;
+            return it;
+        }
+
+        bool operator==(const const_iterator& other) const noexcept { return m_node == other.m_node; }
+
+    private:
+        friend class RBT;
+
+        const_iterator(const RBT* tree, const Node* node) : m_tree{ tree }, m_node{ node } { }
+
+        const RBT* m_tree{ nullptr };
+        const Node* m_node{ nullptr }; // Tnil at end()
+    };
+
+    // the values are the keys, they can't be changed in place
+    using iterator = const_iterator;
+
+    RBT() { }
+
+    // Builds the tree from the sorted range [first, last) in O(n): a balanced tree whose deepest level
+    // is red unless the tree is perfect.
+    template <typename It>
+    RBT(It first, It last) : RBT() {
+        std::vector<T> values(first, last);
+        if (values.empty()) return;
+
+        int depth = std::bit_width(values.size()) - 1;
+        bool perfect{ values.size() == (std::size_t{ 2 } << depth) - 1 };
+        root = build(values, 0, values.size(), 0, perfect ? -1 : depth);
+        root->parent = Tnil;
+    }
+
+    RBT(const RBT&) = delete;
+    RBT& operator=(const RBT&) = delete;
+
+    // Moving a tree invalidates the handles extracted from it.
+    RBT(RBT&& other) : m_alloc{ std::move(other.m_alloc) }, root{ other.root } {
+        other.root = Tnil;
+    }
+
+    RBT& operator=(RBT&& other) {
+        if (this != &other) {
+            cleaner();
+            m_alloc = std::move(other.m_alloc);
+            root = other.root;
+            other.root = Tnil;
+        }
+        return *this;
     }
 
     ~RBT() {
@@ -48,16 +217,151 @@ public:
         printLevelOrderHelper(root);
     }
 
-    bool search(T val) {
+    bool search(T val) const {
         return searchHelper(root, val);
     }
 
+    const_iterator begin() const {
+        const Node* node{ root };
+        while (node != Tnil && node->left != Tnil) node = node->left;
+        return { this, node };
+    }
+
+    const_iterator end() const { return { this, Tnil }; }
+
+    // first value >= val
+    const_iterator lower_bound(const T& val) const {
+        const Node* result{ Tnil };
+        for (const Node* node{ root }; node != Tnil; ) {
+            if (node->m_val < val) {
+                node = node->right;
+            } else {
+                result = node;
+                node = node->left;
+            }
+        }
+        return { this, result };
+    }
+
+    // first value > val
+    const_iterator upper_bound(const T& val) const {
+        const Node* result{ Tnil };
+        for (const Node* node{ root }; node != Tnil; ) {
+            if (val < node->m_val) {
+                result = node;
+                node = node->left;
+            } else {
+                node = node->right;
+            }
+        }
+        return { this, result };
+    }
+
+    // Calls visit(value) for the values in [lo, hi) in increasing order in O(log n + k) for k values.
+    // A visitor that returns bool stops the scan by returning false.
+    template <typename Visitor>
+    void rangeScan(const T& lo, const T& hi, Visitor&& visit) const {
+        augment::rangeScan<Node>(root, Tnil, lo, hi, visit);
+    }
+
     void insert(T val) {
-        insertHelper(val);
+        insertHelper(m_alloc.create(val));
+    }
+
+    // Links the handle's node into the tree, a handle from another tree is inserted as a copy of its value.
+    void insert(NodeHandle&& handle) {
+        if (handle.empty()) return;
+        if (handle.m_alloc != &m_alloc) {
+            insert(handle.value());
+            handle.reset();
+            return;
+        }
+
+        insertHelper(std::exchange(handle.m_node, nullptr));
+    }
+
+    std::size_t size() const noexcept { return root->m_size; }
+
+    // k-th smallest value (0-based), nothing if k >= size()
+    std::optional<T> select(std::size_t k) const {
+        const Node* node{ augment::select<Node>(root, Tnil, k) };
+        if (node == Tnil) return std::nullopt;
+        return node->m_val;
+    }
+
+    // number of values less than val
+    std::size_t rank(const T& val) const {
+        return augment::rank<Node>(root, Tnil, val);
+    }
+
+    // number of values in [lo, hi)
+    std::size_t countInRange(const T& lo, const T& hi) const {
+        if (!(lo < hi)) return 0;
+        return rank(hi) - rank(lo);
+    }
+
+    // Augment aggregate of the values in [lo, hi)
+    typename Augment::value_type rangeAggregate(const T& lo, const T& hi) const {
+        return augment::rangeAggregate<Augment, Node>(root, Tnil, lo, hi);
     }
 
     void remove(T val) {
-        removeHelper(val);
+        Node* z{ removeHelper(val) };
+        if (z != Tnil) m_alloc.destroy(z);
+    }
+
+    // Unlinks a node holding val and returns it, the handle is empty if val isn't in the tree.
+    NodeHandle extract(const T& val) {
+        Node* z{ removeHelper(val) };
+        return NodeHandle(z == Tnil ? nullptr : z, &m_alloc);
+    }
+
+    /*
+    * Join based bulk operations. The trees share their sentinel and merge their pools in O(1), so join
+    * and split take O(log n) and nodes move between the trees without being touched.
+    */
+
+    // Appends the values of greater, which must all be >= the values of this tree, greater ends up empty.
+    void join(RBT&& greater) {
+        Node* other{ adopt(greater) };
+        root = join2(root, other);
+        finish();
+    }
+
+    // Moves the values >= key to the returned tree.
+    RBT split(const T& key) {
+        RBT result{ m_alloc.share() };
+        auto [less, notLess] = splitHelper(root, key);
+        root = less;
+        finish();
+
+        result.root = notLess;
+        result.finish();
+        return result;
+    }
+
+    // Adds all values of other, so values in both trees end up twice, and other ends up empty.
+    // The two halves of every recursion step run in parallel near the top of the trees.
+    void unionWith(RBT&& other) {
+        Node* otherRoot{ adopt(other) };
+        root = unionHelper(root, otherRoot, 0);
+        finish();
+    }
+
+    // Keeps the values that other contains too.
+    void intersectWith(const RBT& other) {
+        std::vector<Node*> dropped;
+        root = filter(root, [&other](const T& val) { return other.search(val); }, 0, dropped);
+        finish();
+        for (Node* node : dropped) m_alloc.destroy(node);
+    }
+
+    // Removes the values that other contains.
+    void subtract(const RBT& other) {
+        std::vector<Node*> dropped;
+        root = filter(root, [&other](const T& val) { return !other.search(val); }, 0, dropped);
+        finish();
+        for (Node* node : dropped) m_alloc.destroy(node);
     }
 
 private:
@@ -114,7 +418,7 @@ private:
         }
     }
 
-    bool searchHelper(Node* node, T val) {
+    bool searchHelper(Node* node, T val) const {
         if (node == Tnil) return false;
 
         if (node->m_val == val) return true;
@@ -134,6 +438,19 @@ private:
         return node;
     }
 
+    // recomputes the cached fields of node from its children
+    void update(Node* node) {
+        node->m_size = node->left->m_size + node->right->m_size + 1;
+        if constexpr (!std::is_empty_v<typename Augment::value_type>) {
+            node->m_agg = Augment::combine(Augment::combine(node->left->m_agg, Augment::lift(node->m_val)), node->right->m_agg);
+        }
+    }
+
+    // updates node and all of its ancestors
+    void updatePath(Node* node) {
+        for (; node != Tnil; node = node->parent) update(node);
+    }
+
     // v takes u's place, connections fix only for parents.
     void transplant(Node* u, Node* v) {
         if (u->parent == Tnil) {
@@ -143,10 +460,11 @@ private:
         } else {
             u->parent->right = v;
         }
-        v->parent = u->parent;
+        if (v != Tnil) v->parent = u->parent;
     }
 
     void leftRotate(Node* y) {
+        stats::count(stats::rotations);
         Node* x{ y->right };
         y->right = x->left;
 
@@ -163,9 +481,13 @@ private:
         }
         x->left = y;
         y->parent = x;
+
+        update(y);
+        update(x);
     }
 
     void rightRotate(Node* y) {
+        stats::count(stats::rotations);
         Node* x{ y->left };
         y->left = x->right;
 
@@ -184,12 +506,16 @@ private:
 
         x->right = y;
         y->parent = x;
+
+        update(y);
+        update(x);
     }
 
-    void insertHelper(T val) {
-        Node* z{ new Node(val) };
+    // links z, a node that isn't in the tree
+    void insertHelper(Node* z) {
         z->left = z->right = z->parent = Tnil;
         z->m_color = COLOR::RED;
+        update(z);
 
         Node* y{ Tnil };
         Node* x{ root };
@@ -213,6 +539,7 @@ private:
         } else {
             y->right = z;
         }
+        updatePath(y);
 
         // if z's grandparent is Tnil than z id the root's child, nothing should be fixed then
         if (z->parent->parent == Tnil) return;
@@ -264,7 +591,8 @@ private:
         root->m_color = COLOR::BLACK;
     }
 
-    void removeHelper(T val) {
+    // unlinks a node holding val and returns it, or returns Tnil if there is none
+    Node* removeHelper(const T& val) {
         Node* z{ Tnil };
         Node* node{ root };
 
@@ -279,19 +607,18 @@ private:
             }
         }
 
-        if (z == Tnil) {
-            std::cout << "WARNING: no key: " << val << " was found in the tree" << std::endl;
-        }
+        if (z == Tnil) return Tnil;
 
         Node* y{ z };
         Node* x{ Tnil };
+        Node* xParent{ z->parent }; // x can be Tnil, which has no parent of its own
         COLOR originalColor{ y->m_color };
 
         if (z->left == Tnil) {
             x = z->right;
             transplant(z, z->right);
         } else if (z->right == Tnil) {
-            x = z->right;
+            x = z->left;
             transplant(z, z->left);
         } else {
             y = getMin(z->right);
@@ -300,8 +627,9 @@ private:
             x = y->right;
 
             if (y->parent == z) {
-                x->parent = y;
+                xParent = y;
             } else {
+                xParent = y->parent;
                 transplant(y, y->right);
                 y->right = z->right;
                 y->right->parent = y;
@@ -311,101 +639,356 @@ private:
             y->left = z->left;
             y->left->parent = y;
             y->m_color = z->m_color;
+        }
 
-            z = nullptr;
+        // x's parent is the lowest node whose subtree lost a node
+        updatePath(xParent);
 
-            if (originalColor == COLOR::BLACK) {
-                removeFixUp(x);
-            }
+        // removing a black node shortens its paths, whichever case took it out
+        if (originalColor == COLOR::BLACK) {
+            removeFixUp(x, xParent);
         }
+
+        z->left = z->right = z->parent = nullptr;
+        z->m_color = COLOR::RED;
+        return z;
     }
 
-    void removeFixUp(Node* x) {
+    // xParent is x's parent, passed along since x may be the shared Tnil
+    void removeFixUp(Node* x, Node* xParent) {
         Node* w{ Tnil }; // uncle
 
         while (x != root && x->m_color == COLOR::BLACK) {
-            if (x == x->parent->left) {
-                w = x->parent->right;
+            if (x == xParent->left) {
+                w = xParent->right;
                 if (w->m_color == COLOR::RED) { // case 1
                     w->m_color = COLOR::BLACK;
-                    x->parent->m_color = COLOR::RED;
-                    leftRotate(x->parent);
-                    w = x->parent->right;
+                    xParent->m_color = COLOR::RED;
+                    leftRotate(xParent);
+                    w = xParent->right;
                 }
         
                 if (w->left->m_color == COLOR::BLACK && w->right->m_color == COLOR::BLACK) { // case 2
                     w->m_color = COLOR::RED;
-                    x = x->parent;
+                    x = xParent;
+                    xParent = x->parent;
                 } else {
                     if (w->right->m_color == COLOR::BLACK) { // case 3
                         w->left->m_color = COLOR::BLACK;
                         w->m_color = COLOR::RED;
                         rightRotate(w);
-                        w = x->parent->right;
+                        w = xParent->right;
                     }
 
-                    w->m_color = x->parent->m_color; // case 4
-                    x->parent->m_color = COLOR::BLACK;
+                    w->m_color = xParent->m_color; // case 4
+                    xParent->m_color = COLOR::BLACK;
                     w->right->m_color = COLOR::BLACK;
-                    leftRotate(x->parent);
+                    leftRotate(xParent);
                     x = root; // nothing more to be done
                 }
-            } else { // mirror version (x == x->parent->right)
-                w = x->parent->left;
+            } else { // mirror version (x == xParent->right)
+                w = xParent->left;
                 if (w->m_color == COLOR::RED) {
                     w->m_color = COLOR::BLACK;
-                    x->parent->m_color = COLOR::RED;
-                    rightRotate(x->parent);
-                    w = x->parent->left;
+                    xParent->m_color = COLOR::RED;
+                    rightRotate(xParent);
+                    w = xParent->left;
                 }
 
                 if (w->right->m_color == COLOR::BLACK && w->left->m_color == COLOR::BLACK) {
                     w->m_color = COLOR::RED;
-                    x = x->parent;
+                    x = xParent;
+                    xParent = x->parent;
                 } else {
                     if (w->left->m_color == COLOR::BLACK) {
                         w->right->m_color = COLOR::BLACK;
                         w->m_color = COLOR::RED;
                         leftRotate(w);
-                        w = x->parent->left;
+                        w = xParent->left;
                     }
 
-                    w->m_color = x->parent->m_color;
-                    x->parent->m_color = COLOR::BLACK;
+                    w->m_color = xParent->m_color;
+                    xParent->m_color = COLOR::BLACK;
                     w->left->m_color = COLOR::BLACK;
-                    rightRotate(x->parent);
+                    rightRotate(xParent);
                     x = root;
                 }
             }
         }
 
-        x->m_color = COLOR::BLACK;
+        if (x != Tnil) x->m_color = COLOR::BLACK;
     }
 
-    void cleaner() {
+    // the sentinel of every tree of this instantiation, black with size 0 and the identity
+    static Node* sharedNil() {
+        static Node nil{ [] {
+            Node node{ T{} };
+            node.m_color = COLOR::BLACK;
+            node.m_size = 0;
+            node.m_agg = Augment::identity();
+            return node;
+        }() };
+        return &nil;
+    }
+
+    Node* build(const std::vector<T>& values, std::size_t low, std::size_t high, int depth, int redDepth) {
+        if (low == high) return Tnil;
+
+        std::size_t mid{ low + (high - low) / 2 };
+        Node* node{ m_alloc.create(values[mid]) };
+        node->m_color = depth == redDepth ? COLOR::RED : COLOR::BLACK;
+        link(build(values, low, mid, depth + 1, redDepth), node, build(values, mid + 1, high, depth + 1, redDepth));
+        return node;
+    }
+
+    // takes the nodes of other, which ends up empty, and returns their root
+    Node* adopt(RBT& other) {
+        Node* otherRoot{ other.root };
+        m_alloc.merge(other.m_alloc);
+        other.root = Tnil;
+        return otherRoot;
+    }
+
+    // makes root a valid root again after a bulk operation
+    void finish() {
         if (root == Tnil) return;
+        root->parent = Tnil;
+        root->m_color = COLOR::BLACK;
+    }
 
-        std::queue<Node*> q;
-        q.push(root);
+    bool isRed(const Node* node) const { return node->m_color == COLOR::RED; }
 
-        while (!q.empty()) {
-            Node* tmp{ q.front() };
-            q.pop();
-            
-            if (tmp->left != Tnil) q.push(tmp->left);
-            if (tmp->right != Tnil) q.push(tmp->right);
+    // black nodes on a path from t down to Tnil, t included
+    int blackHeight(const Node* t) const {
+        int height{ 0 };
+        for (; t != Tnil; t = t->left) {
+            if (!isRed(t)) ++height;
+        }
+        return height;
+    }
+
+    // makes l and r the children of k, none of them is linked into a tree above
+    void link(Node* l, Node* k, Node* r) {
+        k->left = l;
+        k->right = r;
+        if (l != Tnil) l->parent = k;
+        if (r != Tnil) r->parent = k;
+        update(k);
+    }
+
+    // rotations of a standalone subtree, the caller links the returned root
+    Node* rotateLeftSubtree(Node* y) {
+        stats::count(stats::rotations);
+        Node* x{ y->right };
+        y->right = x->left;
+        if (x->left != Tnil) x->left->parent = y;
+        x->left = y;
+        y->parent = x;
+        update(y);
+        update(x);
+        return x;
+    }
+
+    Node* rotateRightSubtree(Node* y) {
+        stats::count(stats::rotations);
+        Node* x{ y->left };
+        y->left = x->right;
+        if (x->right != Tnil) x->right->parent = y;
+        x->right = y;
+        y->parent = x;
+        update(y);
+        update(x);
+        return x;
+    }
+
+    // walks down the right spine of l to a black node of r's black height and puts k there,
+    // a red node with a red right child is fixed by a rotation one level up
+    Node* joinRight(Node* l, int lHeight, Node* k, Node* r, int rHeight) {
+        if (lHeight == rHeight && !isRed(l)) {
+            link(l, k, r);
+            k->m_color = COLOR::RED;
+            return k;
+        }
+
+        Node* c{ joinRight(l->right, lHeight - (isRed(l) ? 0 : 1), k, r, rHeight) };
+        l->right = c;
+        c->parent = l;
+        if (!isRed(l) && isRed(c) && isRed(c->right)) {
+            c->right->m_color = COLOR::BLACK;
+            return rotateLeftSubtree(l);
+        }
+
+        update(l);
+        return l;
+    }
+
+    Node* joinLeft(Node* l, int lHeight, Node* k, Node* r, int rHeight) {
+        if (lHeight == rHeight && !isRed(r)) {
+            link(l, k, r);
+            k->m_color = COLOR::RED;
+            return k;
+        }
 
-            delete tmp;
-            tmp = nullptr;
+        Node* c{ joinLeft(l, lHeight, k, r->left, rHeight - (isRed(r) ? 0 : 1)) };
+        r->left = c;
+        c->parent = r;
+        if (!isRed(r) && isRed(c) && isRed(c->left)) {
+            c->left->m_color = COLOR::BLACK;
+            return rotateRightSubtree(r);
         }
 
-        delete Tnil;
-        Tnil = nullptr;
+        update(r);
+        return r;
+    }
+
+    // joins the standalone subtrees l and r with k between them, l <= k <= r
+    Node* join(Node* l, Node* k, Node* r) {
+        // a standalone subtree may have a red root, blacken it so the black heights compare
+        if (isRed(l)) l->m_color = COLOR::BLACK;
+        if (isRed(r)) r->m_color = COLOR::BLACK;
+
+        int lHeight{ blackHeight(l) };
+        int rHeight{ blackHeight(r) };
+        Node* t{ k };
+        if (lHeight > rHeight) {
+            t = joinRight(l, lHeight, k, r, rHeight);
+            if (isRed(t) && isRed(t->right)) t->m_color = COLOR::BLACK;
+        } else if (rHeight > lHeight) {
+            t = joinLeft(l, lHeight, k, r, rHeight);
+            if (isRed(t) && isRed(t->left)) t->m_color = COLOR::BLACK;
+        } else {
+            link(l, k, r);
+            k->m_color = COLOR::RED;
+        }
+
+        t->parent = Tnil;
+        return t;
+    }
+
+    // unlinks the largest node of t, returns the rest of t and that node
+    std::pair<Node*, Node*> splitLast(Node* t) {
+        if (t->right == Tnil) {
+            Node* l{ t->left };
+            if (l != Tnil) l->parent = Tnil;
+            return { l, t };
+        }
+
+        auto [rest, last] = splitLast(t->right);
+        return { join(t->left, t, rest), last };
+    }
+
+    // joins l and r where l <= r
+    Node* join2(Node* l, Node* r) {
+        if (l == Tnil) return r;
+        if (r == Tnil) return l;
+
+        auto [rest, last] = splitLast(l);
+        return join(rest, last, r);
+    }
+
+    // splits t into the values < key and the values >= key
+    std::pair<Node*, Node*> splitHelper(Node* t, const T& key) {
+        if (t == Tnil) return { Tnil, Tnil };
+
+        Node* l{ t->left };
+        Node* r{ t->right };
+        if (t->m_val < key) {
+            auto [less, notLess] = splitHelper(r, key);
+            return { join(l, t, less), notLess };
+        }
+
+        auto [less, notLess] = splitHelper(l, key);
+        return { less, join(notLess, t, r) };
+    }
+
+    // runs left on another thread if parallel, right on this one
+    template <typename Left, typename Right>
+    static void forkJoin(bool parallel, Left&& left, Right&& right) {
+        if (!parallel) {
+            left();
+            right();
+            return;
+        }
+
+        auto future{ std::async(std::launch::async, std::forward<Left>(left)) };
+        right();
+        future.get();
+    }
+
+    static bool runParallel(std::size_t depth, std::size_t size) {
+        static const std::size_t maxDepth = std::bit_width(std::max(1u, std::thread::hardware_concurrency()));
+        return depth < maxDepth && size >= parallelGrain;
+    }
+
+    Node* unionHelper(Node* t1, Node* t2, std::size_t depth) {
+        if (t1 == Tnil) return t2;
+        if (t2 == Tnil) return t1;
+
+        bool parallel{ runParallel(depth, t1->m_size + t2->m_size) };
+        Node* l1{ t1->left };
+        Node* r1{ t1->right };
+        auto [l2, r2] = splitHelper(t2, t1->m_val);
+
+        Node* l{ Tnil };
+        Node* r{ Tnil };
+        forkJoin(parallel,
+            [&, l1 = l1, l2 = l2] { l = unionHelper(l1, l2, depth + 1); },
+            [&, r1 = r1, r2 = r2] { r = unionHelper(r1, r2, depth + 1); });
+
+        return join(l, t1, r);
+    }
+
+    // keeps the nodes of t whose value satisfies pred, the others go to dropped
+    template <typename Pred>
+    Node* filter(Node* t, const Pred& pred, std::size_t depth, std::vector<Node*>& dropped) {
+        if (t == Tnil) return Tnil;
+
+        bool parallel{ runParallel(depth, t->m_size) };
+        Node* l{ Tnil };
+        Node* r{ Tnil };
+        std::vector<Node*> leftDropped;
+        std::vector<Node*>& leftOut{ parallel ? leftDropped : dropped };
+        forkJoin(parallel,
+            [&] { l = filter(t->left, pred, depth + 1, leftOut); },
+            [&] { r = filter(t->right, pred, depth + 1, dropped); });
+        dropped.insert(dropped.end(), leftDropped.begin(), leftDropped.end());
+
+        if (pred(t->m_val)) return join(l, t, r);
+
+        dropped.push_back(t);
+        return join2(l, r);
+    }
+
+    void cleaner() {
+        // the pool frees all the nodes at once when nothing has to be destroyed one by one
+        if constexpr (Alloc<Node>::releasesInBulk && std::is_trivially_destructible_v<Node>) return;
+
+        if (root != Tnil) {
+            std::queue<Node*> q;
+            q.push(root);
+
+            while (!q.empty()) {
+                Node* tmp{ q.front() };
+                q.pop();
+                
+                if (tmp->left != Tnil) q.push(tmp->left);
+                if (tmp->right != Tnil) q.push(tmp->right);
+
+                m_alloc.destroy(tmp);
+                tmp = nullptr;
+            }
+        }
+        root = Tnil;
     }
 
 private:
-    Node* root{ nullptr };
-    Node* Tnil{ nullptr }; // due to Cormen
+    Alloc<Node> m_alloc;
+    Node* Tnil{ sharedNil() }; // due to Cormen
+    Node* root{ Tnil };
+
+    static constexpr std::size_t parallelGrain{ 2048 }; // smaller subproblems aren't worth a task
+
+    explicit RBT(Alloc<Node>&& alloc) : m_alloc{ std::move(alloc) } { }
 };
 
 } // myDS
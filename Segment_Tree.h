@@ -4,95 +4,159 @@
 #include <iostream>
 #include <vector>
 #include <queue>
-#include <cmath> // For pow and log2 functions
+#include <limits>
+#include <span>
+#include <thread>
+#include <utility>
+#include <algorithm>
+#include <cstddef>
+
+#include "Worker_Pool.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE4_1__)
+#include <smmintrin.h>
+#endif
 
 // Class for implementing a Segment Tree for Range Minimum Query (RMQ)
+// The tree is stored bottom-up without recursion: the leaves are m_segTreeArray[n, 2n), node i > 0 is the
+// minimum of nodes 2i and 2i + 1, and m_segTreeArray[0] is unused. This takes 2n ints for any n and
+// queries and updates are plain loops over the leaf-to-root paths.
 class SegmentTreeRMQ
 {
 public:
-    // Constructor to initialize the segment tree with the input data
+    // Constructor to build the segment tree from the input data in O(n)
     // @param data: A vector of integers representing the input array
     SegmentTreeRMQ(const std::vector<int>& data) : m_data{ data }
     {
-        // Calculate the size of the segment tree array, ensuring enough space for the tree
-        size_t treeSize{ getNextPowerOf2(data.size()) * 2 - 1 };
-        m_segTreeArray.resize(treeSize);
+        build();
     }
 
-    // Function to construct the segment tree
-    // @param low: Starting index of the current range in the input array
-    // @param high: Ending index of the current range in the input array
-    // @param pos: Current index in the segment tree array
-    void constructSegTree(int low, int high, int pos)
+    // Function to rebuild the segment tree from the input data
+    // Kept for compatibility, the constructor already builds the tree and the arguments are ignored
+    void constructSegTree(int /*low*/, int /*high*/, int /*pos*/)
     {
-        // Base case: If the range is invalid, return
-        if (low > high) return;
+        build();
+    }
 
-        // Base case: If the range represents a single element, store it in the tree
-        if (low == high) {
-            m_segTreeArray[pos] = m_data[low];
-            return;
-        }
+    // Function to perform a range minimum query, the range isn't checked: 0 <= qLow <= qHigh < n
+    // @param qLow: Query range start index
+    // @param qHigh: Query range end index (inclusive)
+    // @return The minimum value in the specified query range
+    int rangeMinQuery(int qLow, int qHigh) const
+    {
+        size_t n{ m_data.size() };
+        size_t l{ qLow + n };
+        size_t r{ qHigh + n + 1 };
 
-        // Recursive case: Divide the range into two halves
-        int mid{ (high - low) / 2 + low };
-        constructSegTree(low, mid, 2 * pos + 1);    // Left child
-        constructSegTree(mid + 1, high, 2 * pos + 2); // Right child
+        // min is idempotent, so starting from a leaf inside the range needs no neutral element
+        int result{ m_segTreeArray[l] };
+        for (; l < r; l >>= 1, r >>= 1) {
+            if (l & 1) result = std::min(result, m_segTreeArray[l++]);
+            if (r & 1) result = std::min(result, m_segTreeArray[--r]);
+        }
 
-        // Store the minimum of the two child nodes in the current node
-        m_segTreeArray[pos] = std::min(m_segTreeArray[2 * pos + 1], m_segTreeArray[2 * pos + 2]);
+        return result;
     }
 
-    // Function to perform a range minimum query
+    // Recursive style overload kept for existing callers, the position is ignored
+    // The query is clamped to the tree range [low, high] and to the array like the recursive version did
     // @param qLow: Query range start index
     // @param qHigh: Query range end index
-    // @param low: Current range start index in the segment tree
-    // @param high: Current range end index in the segment tree
-    // @param pos: Current index in the segment tree array
-    // @return The minimum value in the specified query range
-    int rangeMinQuery(int qLow, int qHigh, int low, int high, int pos)
+    // @param low: Start index of the tree range
+    // @param high: End index of the tree range
+    // @return The minimum value in the overlap, std::numeric_limits<int>::max() if there is none
+    int rangeMinQuery(int qLow, int qHigh, int low, int high, int /*pos*/) const
     {
-        // Case 1: Complete overlap (query range completely covers the current range)
-        if (qLow <= low && qHigh >= high) {
-            return m_segTreeArray[pos];
-        }
-        // Case 2: No overlap (query range is outside the current range)
-        else if (qLow > high || qHigh < low) {
-            return std::numeric_limits<int>::max(); // Return maximum value as neutral element for min
-        }
-
-        // Case 3: Partial overlap
-        int mid{ (high - low) / 2 + low };
-        int left{ rangeMinQuery(qLow, qHigh, low, mid, 2 * pos + 1) };
-        int right{ rangeMinQuery(qLow, qHigh, mid + 1, high, 2 * pos + 2) };
+        int first{ std::max({ qLow, low, 0 }) };
+        int last{ std::min({ qHigh, high, static_cast<int>(m_data.size()) - 1 }) };
+        if (first > last) return std::numeric_limits<int>::max();
 
-        return std::min(left, right);
+        return rangeMinQuery(first, last);
     }
 
     // Function to update an element in the segment tree
-    // @param start: Start index of the current range in the input tree
-    // @param end: End index of the current range in the input tree
-    // @param pos: Current index in the segment tree array
     // @param index: Index of the element to be updated in the input array
     // @param val: New value to update
-    void update(int start, int end, int pos, int index, int val)
+    void update(int index, int val)
+    {
+        size_t pos{ index + m_data.size() };
+        m_segTreeArray[pos] = m_data[index] = val;
+
+        // Recalculate the ancestors on the way to the root
+        for (pos >>= 1; pos > 0; pos >>= 1) {
+            m_segTreeArray[pos] = std::min(m_segTreeArray[2 * pos], m_segTreeArray[2 * pos + 1]);
+        }
+    }
+
+    // Recursive style overload kept for existing callers, the tree range and position are ignored
+    // @param index: Index of the element to be updated in the input array
+    // @param val: New value to update
+    void update(int /*start*/, int /*end*/, int /*pos*/, int index, int val)
+    {
+        if (index < 0 || static_cast<size_t>(index) >= m_data.size()) return;
+        update(index, val);
+    }
+
+    // Function to answer many queries at once, split into contiguous chunks over several threads
+    // The threads are started by this call, batches issued over and over should go to a WorkerPool instead
+    // @param queries: (qLow, qHigh) pairs, inclusive like rangeMinQuery
+    // @param out: Receives the answer of queries[i] at out[i], must be at least as long as queries
+    // @param numThreads: Number of threads to use, 0 means std::thread::hardware_concurrency()
+    void queryBatch(std::span<const std::pair<int, int>> queries, std::span<int> out, unsigned numThreads = 0) const
     {
-        // If the index is out of the current range, return
-        if (index < start || index > end) return;
+        if (numThreads == 0) numThreads = std::max(1u, std::thread::hardware_concurrency());
+        // below this many queries per thread a thread start costs more than it saves
+        size_t threads{ std::min<size_t>(numThreads, (queries.size() + minQueriesPerThread - 1) / minQueriesPerThread) };
+
+        auto work = [&](size_t first, size_t last) { queryRange(queries, out, first, last); };
 
-        // Base case: If the current range represents a single element, update it
-        if (start == end) {
-            m_segTreeArray[pos] = m_data[index] = val;
+        if (threads <= 1) {
+            work(0, queries.size());
             return;
         }
 
-        // Recursive case: Update the left or right child
-        int mid{ (end - start) / 2 + start };
-        update(start, mid, 2 * pos + 1, index, val);    // Left child
-        update(mid + 1, end, 2 * pos + 2, index, val); // Right child
+        std::vector<std::thread> workers;
+        workers.reserve(threads - 1);
+        size_t chunk{ (queries.size() + threads - 1) / threads };
+        for (size_t t = 1; t < threads; ++t) {
+            workers.emplace_back(work, std::min(t * chunk, queries.size()), std::min((t + 1) * chunk, queries.size()));
+        }
+        work(0, std::min(chunk, queries.size()));
+        for (auto& worker : workers) worker.join();
+    }
 
-        // Recalculate the current node's value after the update
-        m_segTreeArray[pos] = std::min(m_segTreeArray[2 * pos + 1], m_segTreeArray[2 * pos + 2]);
+    // Same as above on threads that outlive the call, which only wakes them up
+    // @param workers: Pool running the chunks, the calling thread takes part as well
+    void queryBatch(std::span<const std::pair<int, int>> queries, std::span<int> out, myDS::WorkerPool& workers) const
+    {
+        workers.parallelFor(queries.size(), minQueriesPerTask, [&](size_t first, size_t last) {
+            queryRange(queries, out, first, last);
+        });
+    }
+
+    // Function to apply many point updates with one recompute pass, each dirty ancestor is recomputed once
+    // @param updates: (index, val) pairs, applied in order so the last update of an index wins
+    void updateBatch(std::span<const std::pair<int, int>> updates)
+    {
+        size_t n{ m_data.size() };
+        std::priority_queue<size_t> dirty;
+        for (const auto& [index, val] : updates) {
+            m_segTreeArray[index + n] = m_data[index] = val;
+            if (index + n > 1) dirty.push((index + n) >> 1);
+        }
+
+        // The children of a node have larger indices, so going from the largest dirty index down recomputes
+        // a node after all of its dirty children, also when n is not a power of two and the leaves are on
+        // two levels. The copies of an index come out together and are recomputed once.
+        while (!dirty.empty()) {
+            size_t pos{ dirty.top() };
+            while (!dirty.empty() && dirty.top() == pos) dirty.pop();
+
+            m_segTreeArray[pos] = std::min(m_segTreeArray[2 * pos], m_segTreeArray[2 * pos + 1]);
+            if (pos > 1) dirty.push(pos >> 1);
+        }
     }
 
     // Function to print the input data and segment tree
@@ -102,10 +166,11 @@ public:
         for (int i : m_data) std::cout << i << " ";
         std::cout << std::endl;
 
-        // Print the segment tree level by level using a queue
-        int n = m_segTreeArray.size();
-        std::queue<int> q;
-        q.push(0);
+        // Print the segment tree level by level using a queue, starting from the root at index 1
+        size_t n = m_segTreeArray.size();
+        if (n < 2) return;
+        std::queue<size_t> q;
+        q.push(1);
 
         while (!q.empty()) {
             int size = q.size();
@@ -116,8 +181,8 @@ public:
 
                 std::cout << m_segTreeArray[index] << " ";
 
-                if (index * 2 + 1 < n) q.push(index * 2 + 1); // Left child
-                if (index * 2 + 2 < n) q.push(index * 2 + 2); // Right child
+                if (index * 2 < n) q.push(index * 2);         // Left child
+                if (index * 2 + 1 < n) q.push(index * 2 + 1); // Right child
             }
 
             std::cout << std::endl;
@@ -125,15 +190,342 @@ public:
     }
 
 private:
-    // Helper function to calculate the next power of 2 greater than or equal to n
-    // @param n: Input number
-    // @return The smallest power of 2 greater than or equal to n
-    size_t getNextPowerOf2(size_t n) const noexcept
+    static constexpr size_t minQueriesPerThread{ 4096 }; // per thread started by a call
+    static constexpr size_t minQueriesPerTask{ 512 };    // per chunk handed to a running pool thread
+
+    void queryRange(std::span<const std::pair<int, int>> queries, std::span<int> out, size_t first, size_t last) const
     {
-        return pow(2, std::ceil(std::log2(n + 1)));
+        for (size_t i = first; i < last; ++i) out[i] = rangeMinQuery(queries[i].first, queries[i].second);
+    }
+
+    // Function to fill the leaves from m_data and compute the internal nodes bottom-up
+    void build()
+    {
+        size_t n{ m_data.size() };
+        m_segTreeArray.assign(2 * n, 0);
+        std::copy(m_data.begin(), m_data.end(), m_segTreeArray.begin() + n);
+        if (n == 0) return;
+        for (size_t pos = n - 1; pos > 0; --pos) {
+            m_segTreeArray[pos] = std::min(m_segTreeArray[2 * pos], m_segTreeArray[2 * pos + 1]);
+        }
     }
 
 private:
     std::vector<int> m_data;         // Input data array
-    std::vector<int> m_segTreeArray; // Segment tree array
+    std::vector<int> m_segTreeArray; // Segment tree array, leaves at [n, 2n)
+};
+
+// Monoids for SegmentTree. Besides the associative combine and its identity, a monoid says how
+// a range update changes the aggregate of a segment of len elements:
+//   applyAdd(agg, delta, len): aggregate after adding delta to every element
+//   applyAssign(val, len): aggregate of len elements all equal to val
+template<typename T>
+struct SumMonoid
+{
+    static T identity() { return T{}; }
+    static T combine(const T& a, const T& b) { return a + b; }
+    static T applyAdd(const T& agg, const T& delta, size_t len) { return agg + delta * static_cast<T>(len); }
+    static T applyAssign(const T& val, size_t len) { return val * static_cast<T>(len); }
+};
+
+template<typename T>
+struct MinMonoid
+{
+    static T identity() { return std::numeric_limits<T>::max(); }
+    static T combine(const T& a, const T& b) { return std::min(a, b); }
+    static T applyAdd(const T& agg, const T& delta, size_t) { return agg + delta; }
+    static T applyAssign(const T& val, size_t) { return val; }
+};
+
+template<typename T>
+struct MaxMonoid
+{
+    static T identity() { return std::numeric_limits<T>::lowest(); }
+    static T combine(const T& a, const T& b) { return std::max(a, b); }
+    static T applyAdd(const T& agg, const T& delta, size_t) { return agg + delta; }
+    static T applyAssign(const T& val, size_t) { return val; }
+};
+
+// Segment tree over any value type and monoid, with lazy propagation so that range add
+// and range assign run in O(log n) like the queries. All ranges are inclusive [low, high].
+// A node keeps at most one pending assign and one pending add; an add that arrives on top of
+// a pending assign is folded into the assigned value.
+template<typename T, typename Monoid = SumMonoid<T>>
+class SegmentTree
+{
+public:
+    // Constructor to build the tree from the input data in O(n)
+    // @param data: The initial values
+    SegmentTree(const std::vector<T>& data) : m_size{ data.size() }
+    {
+        if (m_size == 0) return;
+        m_nodes.resize(4 * m_size);
+        build(data, 0, m_size - 1, 0);
+    }
+
+    // @return The number of elements
+    size_t size() const noexcept { return m_size; }
+
+    // Function to combine the elements of a range
+    // @param qLow: Query range start index
+    // @param qHigh: Query range end index
+    // @return The combined value of [qLow, qHigh], the identity if the range is empty
+    T query(size_t qLow, size_t qHigh)
+    {
+        if (m_size == 0 || qLow > qHigh || qLow >= m_size) return Monoid::identity();
+        return query(qLow, std::min(qHigh, m_size - 1), 0, m_size - 1, 0);
+    }
+
+    // Function to set a single element
+    // @param index: Index of the element
+    // @param val: New value
+    void update(size_t index, const T& val)
+    {
+        rangeAssign(index, index, val);
+    }
+
+    // Function to add delta to every element of [qLow, qHigh]
+    void rangeAdd(size_t qLow, size_t qHigh, const T& delta)
+    {
+        if (m_size == 0 || qLow > qHigh || qLow >= m_size) return;
+        modify(qLow, std::min(qHigh, m_size - 1), delta, false, 0, m_size - 1, 0);
+    }
+
+    // Function to set every element of [qLow, qHigh] to val
+    void rangeAssign(size_t qLow, size_t qHigh, const T& val)
+    {
+        if (m_size == 0 || qLow > qHigh || qLow >= m_size) return;
+        modify(qLow, std::min(qHigh, m_size - 1), val, true, 0, m_size - 1, 0);
+    }
+
+private:
+    struct Node
+    {
+        T agg{ Monoid::identity() };
+        T pendingAdd{};
+        T pendingAssign{};
+        bool hasAssign{ false };
+    };
+
+    void build(const std::vector<T>& data, size_t low, size_t high, size_t pos)
+    {
+        if (low == high) {
+            m_nodes[pos].agg = data[low];
+            return;
+        }
+
+        size_t mid{ (high - low) / 2 + low };
+        build(data, low, mid, 2 * pos + 1);
+        build(data, mid + 1, high, 2 * pos + 2);
+        m_nodes[pos].agg = Monoid::combine(m_nodes[2 * pos + 1].agg, m_nodes[2 * pos + 2].agg);
+    }
+
+    void applyAssign(size_t pos, const T& val, size_t len)
+    {
+        Node& node{ m_nodes[pos] };
+        node.agg = Monoid::applyAssign(val, len);
+        node.pendingAssign = val;
+        node.pendingAdd = T{};
+        node.hasAssign = true;
+    }
+
+    void applyAdd(size_t pos, const T& delta, size_t len)
+    {
+        Node& node{ m_nodes[pos] };
+        node.agg = Monoid::applyAdd(node.agg, delta, len);
+        if (node.hasAssign) node.pendingAssign += delta;
+        else node.pendingAdd += delta;
+    }
+
+    // Function to hand the pending updates of a node down to its children
+    void push(size_t pos, size_t low, size_t mid, size_t high)
+    {
+        Node& node{ m_nodes[pos] };
+        if (node.hasAssign) {
+            applyAssign(2 * pos + 1, node.pendingAssign, mid - low + 1);
+            applyAssign(2 * pos + 2, node.pendingAssign, high - mid);
+            node.hasAssign = false;
+        }
+        else if (node.pendingAdd != T{}) {
+            applyAdd(2 * pos + 1, node.pendingAdd, mid - low + 1);
+            applyAdd(2 * pos + 2, node.pendingAdd, high - mid);
+            node.pendingAdd = T{};
+        }
+    }
+
+    // The query range is always inside [low, high], so there is no no-overlap case
+    T query(size_t qLow, size_t qHigh, size_t low, size_t high, size_t pos)
+    {
+        if (qLow == low && qHigh == high) return m_nodes[pos].agg;
+
+        size_t mid{ (high - low) / 2 + low };
+        push(pos, low, mid, high);
+        if (qHigh <= mid) return query(qLow, qHigh, low, mid, 2 * pos + 1);
+        if (qLow > mid) return query(qLow, qHigh, mid + 1, high, 2 * pos + 2);
+
+        return Monoid::combine(query(qLow, mid, low, mid, 2 * pos + 1),
+                               query(mid + 1, qHigh, mid + 1, high, 2 * pos + 2));
+    }
+
+    void modify(size_t qLow, size_t qHigh, const T& val, bool assign, size_t low, size_t high, size_t pos)
+    {
+        if (qLow == low && qHigh == high) {
+            if (assign) applyAssign(pos, val, high - low + 1);
+            else applyAdd(pos, val, high - low + 1);
+            return;
+        }
+
+        size_t mid{ (high - low) / 2 + low };
+        push(pos, low, mid, high);
+        if (qLow <= mid) modify(qLow, std::min(qHigh, mid), val, assign, low, mid, 2 * pos + 1);
+        if (qHigh > mid) modify(std::max(qLow, mid + 1), qHigh, val, assign, mid + 1, high, 2 * pos + 2);
+        m_nodes[pos].agg = Monoid::combine(m_nodes[2 * pos + 1].agg, m_nodes[2 * pos + 2].agg);
+    }
+
+private:
+    size_t m_size;             // Number of elements
+    std::vector<Node> m_nodes; // Tree nodes, children of pos at 2 * pos + 1 and 2 * pos + 2
+};
+
+// Wide segment tree for range minimum queries on large arrays. Every node has Fanout children that sit
+// together in one aligned block of half or a whole cache line, so a query touches about two blocks
+// per level and the tree is log_Fanout(n) levels deep instead of log_2(n). The levels are stored
+// bottom-up, level 0 holds the data padded to whole blocks, and the tree takes about
+// n * Fanout / (Fanout - 1) ints.
+// The minimum over part of a block is taken with AVX2 or SSE4.1 when available, with a scalar fallback.
+template<int Fanout = 16>
+class WideSegmentTreeRMQ
+{
+    static_assert(Fanout == 8 || Fanout == 16, "a node block must fill half or all of a 64-byte cache line");
+
+public:
+    // Constructor to build the tree from the input data in O(n)
+    // @param data: A vector of integers representing the input array
+    WideSegmentTreeRMQ(const std::vector<int>& data) : m_size{ data.size() }
+    {
+        // level 0 is the data, each level above has one element per block of the level below
+        size_t levelSize{ std::max<size_t>(m_size, 1) };
+        while (true) {
+            m_levelStart.push_back(m_blocks.size());
+            m_blocks.resize(m_blocks.size() + (levelSize + Fanout - 1) / Fanout);
+            if (levelSize <= Fanout) break;
+            levelSize = (levelSize + Fanout - 1) / Fanout;
+        }
+        for (Block& block : m_blocks) std::fill(std::begin(block.values), std::end(block.values), padding);
+
+        for (size_t i = 0; i < m_size; ++i) at(0, i) = data[i];
+        for (size_t level = 1; level < m_levelStart.size(); ++level) {
+            size_t childBlocks{ m_levelStart[level] - m_levelStart[level - 1] };
+            for (size_t i = 0; i < childBlocks; ++i) {
+                at(level, i) = reduceBlock(m_blocks[m_levelStart[level - 1] + i].values, 0, Fanout - 1);
+            }
+        }
+    }
+
+    // @return The number of elements
+    size_t size() const noexcept { return m_size; }
+
+    // Function to perform a range minimum query
+    // @param qLow: Query range start index
+    // @param qHigh: Query range end index (inclusive), qLow <= qHigh < n
+    // @return The minimum value in the specified query range
+    int rangeMinQuery(size_t qLow, size_t qHigh) const
+    {
+        int result{ padding };
+        for (size_t level = 0;; ++level) {
+            const Block* blocks{ m_blocks.data() + m_levelStart[level] };
+            size_t lowBlock{ qLow / Fanout };
+            size_t highBlock{ qHigh / Fanout };
+            if (lowBlock == highBlock) {
+                return std::min(result, reduceBlock(blocks[lowBlock].values, qLow % Fanout, qHigh % Fanout));
+            }
+
+            // take the partial blocks at both ends here, the whole blocks between them one level up
+            if (qLow % Fanout != 0) {
+                result = std::min(result, reduceBlock(blocks[lowBlock].values, qLow % Fanout, Fanout - 1));
+                ++lowBlock;
+            }
+            if (qHigh % Fanout != Fanout - 1) {
+                result = std::min(result, reduceBlock(blocks[highBlock].values, 0, qHigh % Fanout));
+                if (highBlock-- == lowBlock) return result;
+            }
+            if (lowBlock > highBlock) return result;
+
+            qLow = lowBlock;
+            qHigh = highBlock;
+        }
+    }
+
+    // Function to update an element in the tree
+    // @param index: Index of the element to be updated in the input array
+    // @param val: New value to update
+    void update(size_t index, int val)
+    {
+        at(0, index) = val;
+        for (size_t level = 1; level < m_levelStart.size(); ++level) {
+            size_t block{ index / Fanout };
+            at(level, block) = reduceBlock(m_blocks[m_levelStart[level - 1] + block].values, 0, Fanout - 1);
+            index = block;
+        }
+    }
+
+private:
+    // aligned to its own size so a block never straddles a cache line
+    struct alignas(sizeof(int) * Fanout) Block
+    {
+        int values[Fanout];
+    };
+
+    // fills the unused tail of the last block of every level, it never wins a min
+    static constexpr int padding{ std::numeric_limits<int>::max() };
+
+    int& at(size_t level, size_t index)
+    {
+        return m_blocks[m_levelStart[level] + index / Fanout].values[index % Fanout];
+    }
+
+    // Function to take the minimum of block[low..high], the whole block is loaded and the lanes
+    // outside the range are masked out
+    static int reduceBlock(const int* block, size_t low, size_t high) noexcept
+    {
+#if defined(__AVX2__)
+        const __m256i maxValue{ _mm256_set1_epi32(padding) };
+        const __m256i lowIndex{ _mm256_set1_epi32(static_cast<int>(low)) };
+        const __m256i highIndex{ _mm256_set1_epi32(static_cast<int>(high)) };
+        __m256i index{ _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7) };
+        __m256i acc{ maxValue };
+        for (int base = 0; base < Fanout; base += 8) {
+            __m256i outside{ _mm256_or_si256(_mm256_cmpgt_epi32(lowIndex, index), _mm256_cmpgt_epi32(index, highIndex)) };
+            __m256i values{ _mm256_load_si256(reinterpret_cast<const __m256i*>(block + base)) };
+            acc = _mm256_min_epi32(acc, _mm256_blendv_epi8(values, maxValue, outside));
+            index = _mm256_add_epi32(index, _mm256_set1_epi32(8));
+        }
+        __m128i m{ _mm_min_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1)) };
+        m = _mm_min_epi32(m, _mm_shuffle_epi32(m, _MM_SHUFFLE(1, 0, 3, 2)));
+        m = _mm_min_epi32(m, _mm_shuffle_epi32(m, _MM_SHUFFLE(2, 3, 0, 1)));
+        return _mm_cvtsi128_si32(m);
+#elif defined(__SSE4_1__)
+        const __m128i maxValue{ _mm_set1_epi32(padding) };
+        const __m128i lowIndex{ _mm_set1_epi32(static_cast<int>(low)) };
+        const __m128i highIndex{ _mm_set1_epi32(static_cast<int>(high)) };
+        __m128i index{ _mm_setr_epi32(0, 1, 2, 3) };
+        __m128i acc{ maxValue };
+        for (int base = 0; base < Fanout; base += 4) {
+            __m128i outside{ _mm_or_si128(_mm_cmpgt_epi32(lowIndex, index), _mm_cmpgt_epi32(index, highIndex)) };
+            __m128i values{ _mm_load_si128(reinterpret_cast<const __m128i*>(block + base)) };
+            acc = _mm_min_epi32(acc, _mm_blendv_epi8(values, maxValue, outside));
+            index = _mm_add_epi32(index, _mm_set1_epi32(4));
+        }
+        acc = _mm_min_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+        acc = _mm_min_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+        return _mm_cvtsi128_si32(acc);
+#else
+        return *std::min_element(block + low, block + high + 1);
+#endif
+    }
+
+private:
+    size_t m_size;                   // Number of elements
+    std::vector<Block> m_blocks;     // All levels, bottom-up
+    std::vector<size_t> m_levelStart; // First block of every level
 };
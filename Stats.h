@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace myDS {
+
+    /*
+    * Counters on the hot paths of the data structures, for telling why a change made something faster
+    * or slower. They are compiled in only when MYDS_ENABLE_STATS is defined (the same way in every
+    * translation unit of the program), otherwise counting is an empty inline function and costs nothing.
+    * The counters are process wide and relaxed atomics, so they can be bumped from the worker threads of
+    * the parallel operations, and they are read as a whole with stats::snapshot().
+    */
+    struct Stats {
+        std::uint64_t rotations{0};            // AVL and RBT rotations, rebalancing and join
+        std::uint64_t nodeSplits{0};           // BTree and BPlusTree node splits
+        std::uint64_t failureLinkHops{0};      // failure links followed while building an Aho_Corasick
+        std::uint64_t pathCompressionSteps{0}; // parent links shortened by the UnionFind finds
+    };
+
+    namespace stats {
+
+        enum Counter { rotations, nodeSplits, failureLinkHops, pathCompressionSteps, counterCount };
+
+#ifdef MYDS_ENABLE_STATS
+        inline constexpr bool enabled{ true };
+
+        inline std::atomic<std::uint64_t> g_counters[counterCount]{};
+
+        inline void count(Counter counter, std::uint64_t n = 1) noexcept {
+            g_counters[counter].fetch_add(n, std::memory_order_relaxed);
+        }
+
+        inline Stats snapshot() noexcept {
+            return { g_counters[rotations].load(std::memory_order_relaxed),
+                     g_counters[nodeSplits].load(std::memory_order_relaxed),
+                     g_counters[failureLinkHops].load(std::memory_order_relaxed),
+                     g_counters[pathCompressionSteps].load(std::memory_order_relaxed) };
+        }
+
+        inline void reset() noexcept {
+            for (auto& counter : g_counters) counter.store(0, std::memory_order_relaxed);
+        }
+#else
+        inline constexpr bool enabled{ false };
+
+        inline void count(Counter, std::uint64_t = 1) noexcept { }
+
+        inline Stats snapshot() noexcept { return {}; }
+
+        inline void reset() noexcept { }
+#endif
+
+    } // stats
+
+} // myDS
@@ -0,0 +1,191 @@
+#pragma once
+
+#include <cstddef>
+#include <limits>
+#include <algorithm>
+#include <type_traits>
+
+namespace myDS {
+
+    /*
+    * Aggregates maintained by AVL and RBT next to the subtree sizes. An aggregate is a monoid over
+    * the values of a subtree, combined in key order:
+    *   value_type            type of the aggregate
+    *   identity()            aggregate of an empty range
+    *   lift(val)             aggregate of a single value
+    *   combine(a, b)         aggregate of a range followed by another, must be associative
+    * The trees recompute a node's aggregate from its children whenever the subtree changes, in the
+    * rotations and on the paths touched by insert and remove, so every update stays O(log n).
+    */
+
+    // Only subtree sizes, the aggregate takes no space in the nodes.
+    template <typename T>
+    struct NoAggregate {
+        struct value_type { };
+        static value_type identity() { return {}; }
+        static value_type lift(const T&) { return {}; }
+        static value_type combine(value_type, value_type) { return {}; }
+    };
+
+    template <typename T>
+    struct SumAggregate {
+        using value_type = T;
+        static value_type identity() { return T{}; }
+        static value_type lift(const T& val) { return val; }
+        static value_type combine(const value_type& a, const value_type& b) { return a + b; }
+    };
+
+    template <typename T>
+    struct MinAggregate {
+        using value_type = T;
+        static value_type identity() { return std::numeric_limits<T>::max(); }
+        static value_type lift(const T& val) { return val; }
+        static value_type combine(const value_type& a, const value_type& b) { return std::min(a, b); }
+    };
+
+    template <typename T>
+    struct MaxAggregate {
+        using value_type = T;
+        static value_type identity() { return std::numeric_limits<T>::lowest(); }
+        static value_type lift(const T& val) { return val; }
+        static value_type combine(const value_type& a, const value_type& b) { return std::max(a, b); }
+    };
+
+    /*
+    * Order statistic queries and range scans shared by the trees. They work on any binary search tree node with
+    * m_val, left, right, m_size and m_agg members, nil is the node that ends the paths
+    * (nullptr for AVL, Tnil for RBT).
+    */
+    namespace augment {
+
+        template <typename Node>
+        std::size_t size(const Node* node, const Node* nil) {
+            return node == nil ? 0 : node->m_size;
+        }
+
+        // node holding the k-th smallest value (0-based), nil if k is out of range
+        template <typename Node>
+        const Node* select(const Node* node, const Node* nil, std::size_t k) {
+            while (node != nil) {
+                std::size_t leftSize{ size(node->left, nil) };
+                if (k < leftSize) {
+                    node = node->left;
+                }
+                else if (k == leftSize) {
+                    return node;
+                }
+                else {
+                    k -= leftSize + 1;
+                    node = node->right;
+                }
+            }
+            return nil;
+        }
+
+        // number of values less than val
+        template <typename Node, typename T>
+        std::size_t rank(const Node* node, const Node* nil, const T& val) {
+            std::size_t result{ 0 };
+            while (node != nil) {
+                if (node->m_val < val) {
+                    result += size(node->left, nil) + 1;
+                    node = node->right;
+                }
+                else {
+                    node = node->left;
+                }
+            }
+            return result;
+        }
+
+        template <typename Augment, typename Node>
+        typename Augment::value_type aggregate(const Node* node, const Node* nil) {
+            return node == nil ? Augment::identity() : node->m_agg;
+        }
+
+        // aggregate of the values >= lo
+        template <typename Augment, typename Node, typename T>
+        typename Augment::value_type aggregateFrom(const Node* node, const Node* nil, const T& lo) {
+            typename Augment::value_type result{ Augment::identity() };
+            while (node != nil) {
+                if (node->m_val < lo) {
+                    node = node->right;
+                }
+                else {
+                    // the node and its right subtree are in, prepend them to what was found further right
+                    result = Augment::combine(Augment::combine(Augment::lift(node->m_val), aggregate<Augment>(node->right, nil)), result);
+                    node = node->left;
+                }
+            }
+            return result;
+        }
+
+        // aggregate of the values < hi
+        template <typename Augment, typename Node, typename T>
+        typename Augment::value_type aggregateBelow(const Node* node, const Node* nil, const T& hi) {
+            typename Augment::value_type result{ Augment::identity() };
+            while (node != nil) {
+                if (node->m_val < hi) {
+                    result = Augment::combine(result, Augment::combine(aggregate<Augment>(node->left, nil), Augment::lift(node->m_val)));
+                    node = node->right;
+                }
+                else {
+                    node = node->left;
+                }
+            }
+            return result;
+        }
+
+        // aggregate of the values in [lo, hi)
+        template <typename Augment, typename Node, typename T>
+        typename Augment::value_type rangeAggregate(const Node* node, const Node* nil, const T& lo, const T& hi) {
+            // find the node where the paths to lo and hi split
+            while (node != nil) {
+                if (node->m_val < lo) {
+                    node = node->right;
+                }
+                else if (!(node->m_val < hi)) {
+                    node = node->left;
+                }
+                else {
+                    return Augment::combine(Augment::combine(aggregateFrom<Augment>(node->left, nil, lo), Augment::lift(node->m_val)),
+                                            aggregateBelow<Augment>(node->right, nil, hi));
+                }
+            }
+            return Augment::identity();
+        }
+
+        // calls visit(val), a visitor that returns bool asks to go on with true and to stop with false
+        template <typename Visitor, typename T>
+        bool visitValue(Visitor& visit, const T& val) {
+            if constexpr (std::is_same_v<std::invoke_result_t<Visitor&, const T&>, bool>) {
+                return visit(val);
+            }
+            else {
+                visit(val);
+                return true;
+            }
+        }
+
+        // visits the values in [lo, hi) in order, O(log n + k) for k values, false if the visitor stopped
+        template <typename Node, typename T, typename Visitor>
+        bool rangeScan(const Node* node, const Node* nil, const T& lo, const T& hi, Visitor& visit) {
+            while (node != nil) {
+                if (node->m_val < lo) {
+                    node = node->right;
+                }
+                else if (!(node->m_val < hi)) {
+                    node = node->left;
+                }
+                else {
+                    if (!rangeScan(node->left, nil, lo, hi, visit)) return false;
+                    if (!visitValue(visit, node->m_val)) return false;
+                    node = node->right;
+                }
+            }
+            return true;
+        }
+
+    } // augment
+
+} // myDS
@@ -4,32 +4,151 @@
 #include <iostream>
 #include <unordered_map>
 #include <queue>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <string_view>
+#include <type_traits>
+#include <cstring>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <functional>
 
+// Nodes are kept in one pool (m_nodes) and addressed by 32-bit indices, the root is m_nodes[0].
+// The edges live in the pool as well: a node links to its first child and to its next sibling, siblings are
+// sorted by char, so an insert allocates nothing beyond the pool and the words come out in lexicographic order.
+// Removed nodes go to a free list and are reused by later inserts, the pool is released at once on destruction.
+// Every word has a score (0 unless given) and every node caches the best score below it,
+// which lets topK() skip whole subtrees that can't beat the completions found so far.
 class Trie {
 private:
+    using NodeIndex = std::uint32_t;
+
+    static constexpr NodeIndex root {0};
+    static constexpr NodeIndex noNode {UINT32_MAX};
+
     struct Node {
-        std::unordered_map<char, Node*> m_map;
+        NodeIndex m_firstChild {noNode};
+        NodeIndex m_nextSibling {noNode};
+        std::uint32_t score {0};    // score of the word ending here
+        std::uint32_t maxScore {0}; // best score of the words in this subtree
+        char m_char {'\0'};         // label of the edge from the parent
         bool isWord {false};
     };
 
-    Node* root {nullptr};
+    std::vector<Node> m_nodes;
+    std::vector<NodeIndex> m_freeNodes;
+
+    NodeIndex newNode() {
+        if (!m_freeNodes.empty()) {
+            NodeIndex index = m_freeNodes.back();
+            m_freeNodes.pop_back();
+            return index;
+        }
+        m_nodes.emplace_back();
+        return static_cast<NodeIndex>(m_nodes.size() - 1);
+    }
+
+    void releaseNode(NodeIndex index) {
+        m_nodes[index] = Node{};
+        m_freeNodes.push_back(index);
+    }
+
+    // chars are ordered as unsigned, like std::string compares them
+    static bool charLess(char a, char b) {
+        return static_cast<unsigned char>(a) < static_cast<unsigned char>(b);
+    }
+
+    // the link that points to the child of node for c, or to where it would be inserted
+    NodeIndex* findLink(NodeIndex node, char c) {
+        NodeIndex* link = &m_nodes[node].m_firstChild;
+        while (*link != noNode && charLess(m_nodes[*link].m_char, c)) link = &m_nodes[*link].m_nextSibling;
+        return link;
+    }
+
+    // the child of node for c, created if there is none
+    NodeIndex addChild(NodeIndex node, char c) {
+        NodeIndex next = getChild(node, c);
+        if (next != root) return next;
+
+        // newNode may grow the pool, so the links are looked up after it
+        next = newNode();
+        NodeIndex* link = findLink(node, c);
+        m_nodes[next].m_char = c;
+        m_nodes[next].m_nextSibling = *link;
+        *link = next;
+        return next;
+    }
+
+    void unlinkChild(NodeIndex node, char c) {
+        NodeIndex* link = findLink(node, c);
+        *link = m_nodes[*link].m_nextSibling;
+    }
+
+    // recomputes maxScore of node from its own word and its children
+    void pullScore(NodeIndex index) {
+        Node& node = m_nodes[index];
+        node.maxScore = node.isWord ? node.score : 0;
+        for (NodeIndex child = node.m_firstChild; child != noNode; child = m_nodes[child].m_nextSibling) {
+            node.maxScore = std::max(node.maxScore, m_nodes[child].maxScore);
+        }
+    }
+
+    // the node startsWith walks to, root for an empty prefix and noNode if the prefix leaves the trie
+    NodeIndex walk(const std::string& prefix) const {
+        NodeIndex node = root;
+        for (char c : prefix) {
+            node = getChild(node, c);
+            if (node == root) {
+                return noNode;
+            }
+        }
+        return node;
+    }
+
+    // DFS below node, word holds the path so far and is extended in place
+    template <typename Visitor>
+    bool forEachHelper(NodeIndex node, std::string& word, Visitor& visit) const {
+        if (m_nodes[node].isWord) {
+            if constexpr (std::is_same_v<std::invoke_result_t<Visitor&, std::string_view>, bool>) {
+                if (!visit(std::string_view(word))) return false;
+            } else {
+                visit(std::string_view(word));
+            }
+        }
+        for (NodeIndex child = m_nodes[node].m_firstChild; child != noNode; child = m_nodes[child].m_nextSibling) {
+            word.push_back(m_nodes[child].m_char);
+            bool goOn = forEachHelper(child, word, visit);
+            word.pop_back();
+            if (!goOn) return false;
+        }
+        return true;
+    }
+
+    // returns the child of node for c, or root if there is none (root is never a child)
+    NodeIndex getChild(NodeIndex node, char c) const {
+        NodeIndex child = m_nodes[node].m_firstChild;
+        while (child != noNode && charLess(m_nodes[child].m_char, c)) child = m_nodes[child].m_nextSibling;
+        return (child != noNode && m_nodes[child].m_char == c) ? child : root;
+    }
 
 public:
     void print() {
-        std::queue<Node*> q;
+        std::queue<NodeIndex> q;
         q.push(root);
         while (!q.empty()) {
             int size = q.size();
             while (size--) {
-                auto node = q.front();
+                const Node& node = m_nodes[q.front()];
                 q.pop();
-                // std::cout << "node is a word = " << std::boolalpha << node->isWord << std::endl;
+                // std::cout << "node is a word = " << std::boolalpha << node.isWord << std::endl;
                 // std::cout << "node's chars: ";
-                std::string word = (node->isWord) ? "T" : "F";
+                std::string word = (node.isWord) ? "T" : "F";
                 std::cout << "Node(" << word << "): ";
-                for (const auto& p : node->m_map) {
-                    std::cout << p.first << " ";
-                    q.push(p.second);
+                for (NodeIndex child = node.m_firstChild; child != noNode; child = m_nodes[child].m_nextSibling) {
+                    std::cout << m_nodes[child].m_char << " ";
+                    q.push(child);
                 }
                 std::cout << ", ";
             }
@@ -38,107 +157,855 @@ public:
     }
 public:
     Trie() {
-        root = new Node();
+        m_nodes.emplace_back();
+    }
+
+    // reserves room for nodeCount nodes, e.g. the total length of a dictionary about to be inserted
+    void reserve(std::size_t nodeCount) {
+        m_nodes.reserve(nodeCount);
     }
     
     void insert(const std::string& word) {
         if (word.empty()) return;
-        Node* curr = root;
-        int i = 0;
+        NodeIndex curr = root;
+        std::size_t i = 0;
         for (; i < word.size(); ++i) {
-            char c = word[i];
-            if (curr->m_map.find(c) == curr->m_map.end()) {
-                Node* node = new Node();
-                curr->m_map[c] = node;
-            }
-            curr = curr->m_map[c];
+            curr = addChild(curr, word[i]);
+        }
+        m_nodes[curr].isWord = true;
+    }
+
+    // inserts the word or updates its score
+    void insert(const std::string& word, std::uint32_t score) {
+        if (word.empty()) return;
+        insert(word);
+
+        std::vector<NodeIndex> path {root};
+        for (char c : word) path.push_back(getChild(path.back(), c));
+
+        Node& last = m_nodes[path.back()];
+        bool lowered = score < last.score;
+        last.score = score;
+        if (!lowered) {
+            // a raise only needs the maximum pushed up
+            for (NodeIndex node : path) m_nodes[node].maxScore = std::max(m_nodes[node].maxScore, score);
+        } else {
+            for (auto it = path.rbegin(); it != path.rend(); ++it) pullScore(*it);
         }
-        curr->isWord = true;
     }
 
     void insertRecursive(const std::string& word) {
         insertRecursiveHelper(root, word, 0);
     }
 
-    void insertRecursiveHelper(Node* node, const std::string& word, int i) {
+    void insertRecursiveHelper(NodeIndex node, const std::string& word, std::size_t i) {
         if (i == word.size()) {
-            node->isWord = true;
+            m_nodes[node].isWord = true;
             return;
         }
 
-        Node* tmp = node->m_map[word[i]];
-        if (!tmp) {
-            tmp = new Node();
-            node->m_map[word[i]] = tmp;
-        }
-
+        NodeIndex tmp = addChild(node, word[i]);
         insertRecursiveHelper(tmp, word, i + 1);
     }
     
     bool search(const std::string& word) {
-        if (word.empty() || !root) return false;
-        Node* node = root;
+        if (word.empty()) return false;
+        NodeIndex node = root;
         for (char c : word) {
-            if (node->m_map.find(c) == node->m_map.end()) {
+            node = getChild(node, c);
+            if (node == root) {
                 return false;
             }
-            node = node->m_map[c];
         }
-        return node->isWord;
+        return m_nodes[node].isWord;
     }
 
     bool searchRecursive(const std::string& word) {
         return searchRecursiveHelper(root, word, 0);
     }
 
-    bool searchRecursiveHelper(Node* node, const std::string& word, int i) {
+    bool searchRecursiveHelper(NodeIndex node, const std::string& word, std::size_t i) {
         if (i == word.size()) {
-            return node->isWord;
+            return m_nodes[node].isWord;
         }
 
-        Node* tmp = node->m_map[word[i]];
-        if (!tmp) return false;
+        NodeIndex tmp = getChild(node, word[i]);
+        if (tmp == root) return false;
 
         return searchRecursiveHelper(tmp, word, i + 1);
     }
     
     bool startsWith(const std::string& prefix) {
-        if (prefix.empty() || !root) return false;
-        Node* node = root;
-        for (char c : prefix) {
-            if (node->m_map.find(c) == node->m_map.end()) {
-                return false;
+        if (prefix.empty()) return false;
+        return walk(prefix) != noNode;
+    }
+
+    // Calls visit(word) for every word starting with prefix (all words for an empty one), in lexicographic order.
+    // word is a view of a buffer reused between the calls, so it is only valid during the call.
+    // If visit returns bool, returning false stops the enumeration.
+    template <typename Visitor>
+    void forEachWithPrefix(const std::string& prefix, Visitor&& visit) const {
+        NodeIndex node = walk(prefix);
+        if (node == noNode) return;
+
+        std::string word = prefix;
+        forEachHelper(node, word, visit);
+    }
+
+    std::vector<std::string> wordsWithPrefix(const std::string& prefix) const {
+        std::vector<std::string> words;
+        forEachWithPrefix(prefix, [&words](std::string_view word) { words.emplace_back(word); });
+        return words;
+    }
+
+    struct Completion {
+        std::string word;
+        std::uint32_t score;
+    };
+
+    // Returns the k best scored words starting with prefix, best first.
+    // Best-first search on the cached subtree maxima: a subtree is only opened when its best word
+    // could still make it into the result, so the work depends on k and not on the number of completions.
+    std::vector<Completion> topK(const std::string& prefix, std::size_t k) const {
+        std::vector<Completion> result;
+        NodeIndex start = walk(prefix);
+        if (start == noNode || k == 0) return result;
+
+        // the search tree is kept as parent links to rebuild the words of the winners only
+        struct Step {
+            NodeIndex node;
+            std::uint32_t parent;
+            char c;
+        };
+        struct Entry {
+            std::uint32_t priority;
+            std::uint32_t step;
+            bool isWord; // the word ending at the step's node, rather than its subtree
+            bool operator<(const Entry& other) const { return priority < other.priority; }
+        };
+
+        std::vector<Step> steps {{start, UINT32_MAX, '\0'}};
+        std::priority_queue<Entry> q;
+        q.push({m_nodes[start].maxScore, 0, false});
+
+        while (!q.empty() && result.size() < k) {
+            Entry top = q.top();
+            q.pop();
+            const Node& node = m_nodes[steps[top.step].node];
+
+            if (top.isWord) {
+                std::string word;
+                for (std::uint32_t i = top.step; i != 0; i = steps[i].parent) word.push_back(steps[i].c);
+                std::reverse(word.begin(), word.end());
+                result.push_back({prefix + word, node.score});
+                continue;
+            }
+
+            if (node.isWord) q.push({node.score, top.step, true});
+            for (NodeIndex child = node.m_firstChild; child != noNode; child = m_nodes[child].m_nextSibling) {
+                steps.push_back({child, top.step, m_nodes[child].m_char});
+                q.push({m_nodes[child].maxScore, static_cast<std::uint32_t>(steps.size() - 1), false});
             }
-            node = node->m_map[c];
         }
-        return true;
+
+        return result;
     }
 
     void removeWord(const std::string& word) {
         removeWordHelper(root, word, 0);
     }
 
-    bool removeWordHelper(Node* node, const std::string& word, int i) {
+    // returns true if the node became useless (no word ends here and no children) and should be deleted
+    bool removeWordHelper(NodeIndex node, const std::string& word, std::size_t i) {
         if (i == word.size()) {
-            if (!node->isWord) {
+            if (!m_nodes[node].isWord) {
                 return false;
             }
-            node->isWord = false;
-            return node->m_map.empty();
+            m_nodes[node].isWord = false;
+            m_nodes[node].score = 0;
+            pullScore(node);
+            return m_nodes[node].m_firstChild == noNode;
+        }
+
+        NodeIndex tmp = getChild(node, word[i]);
+        if (tmp == root) return false;
+
+        bool shouldDeleteChild = removeWordHelper(tmp, word, i + 1);
+        if (shouldDeleteChild) {
+            unlinkChild(node, word[i]);
+            releaseNode(tmp);
+        }
+        // the removed word may have been the best one below this node
+        pullScore(node);
+        return shouldDeleteChild && node != root && !m_nodes[node].isWord && m_nodes[node].m_firstChild == noNode;
+    }
+};
+
+// Compact trie for large dictionaries: instead of a hash map per node, the children of a node are a sorted run
+// of (label, child) edges in two shared arrays, so a node costs 12 bytes and an edge 5 bytes.
+// The bulk constructor lays the runs out in BFS order with no slack. insert() grows a run in place
+// when it has spare capacity, otherwise moves it to the end of the arrays, and the abandoned slots
+// are reclaimed by shrinkToFit() once they make up half of the edge arrays.
+class CompactTrie {
+private:
+    using NodeIndex = std::uint32_t;
+
+    struct Node {
+        std::uint32_t firstEdge {0};   // the node's children are edges [firstEdge, firstEdge + edgeCount)
+        std::uint16_t edgeCount {0};
+        std::uint16_t edgeCapacity {0}; // edge slots owned by the node starting at firstEdge
+        bool isWord {false};
+    };
+
+    static constexpr NodeIndex root {0};
+
+    std::vector<Node> m_nodes;
+    std::vector<unsigned char> m_labels; // sorted within every run, compared as unsigned the same way std::string is
+    std::vector<NodeIndex> m_targets;
+    std::size_t m_wastedEdges {0};      // slots left behind by relocated runs
+
+    // returns the position of the first edge of node with a label >= c
+    std::uint32_t lowerBound(NodeIndex node, unsigned char c) const {
+        const Node& n = m_nodes[node];
+        const unsigned char* first = m_labels.data() + n.firstEdge;
+        const unsigned char* last = first + n.edgeCount;
+        // a short run is cheaper to scan than to bisect
+        if (n.edgeCount <= 8) {
+            while (first != last && *first < c) ++first;
+        } else {
+            first = std::lower_bound(first, last, c);
+        }
+        return static_cast<std::uint32_t>(first - m_labels.data());
+    }
+
+    // returns the child of node for c, or root if there is none (root is never a child)
+    NodeIndex getChild(NodeIndex node, char c) const {
+        unsigned char label = static_cast<unsigned char>(c);
+        std::uint32_t pos = lowerBound(node, label);
+        const Node& n = m_nodes[node];
+        if (pos != n.firstEdge + n.edgeCount && m_labels[pos] == label) {
+            return m_targets[pos];
+        }
+        return root;
+    }
+
+    NodeIndex addChild(NodeIndex node, char c) {
+        unsigned char label = static_cast<unsigned char>(c);
+        NodeIndex child = static_cast<NodeIndex>(m_nodes.size());
+        m_nodes.emplace_back();
+
+        Node& n = m_nodes[node];
+        if (n.edgeCount == n.edgeCapacity) {
+            // no room left in place, move the run to the end with twice the capacity
+            std::uint32_t newFirst = static_cast<std::uint32_t>(m_labels.size());
+            std::uint16_t newCapacity = static_cast<std::uint16_t>(std::min(256, std::max(2 * n.edgeCapacity, 2)));
+            m_labels.resize(newFirst + newCapacity);
+            m_targets.resize(newFirst + newCapacity);
+            std::copy_n(m_labels.begin() + n.firstEdge, n.edgeCount, m_labels.begin() + newFirst);
+            std::copy_n(m_targets.begin() + n.firstEdge, n.edgeCount, m_targets.begin() + newFirst);
+            m_wastedEdges += n.edgeCapacity;
+            n.firstEdge = newFirst;
+            n.edgeCapacity = newCapacity;
+        }
+
+        // shift the greater labels one slot to the right to keep the run sorted
+        std::uint32_t pos = lowerBound(node, label);
+        std::uint32_t end = n.firstEdge + n.edgeCount;
+        std::copy_backward(m_labels.begin() + pos, m_labels.begin() + end, m_labels.begin() + end + 1);
+        std::copy_backward(m_targets.begin() + pos, m_targets.begin() + end, m_targets.begin() + end + 1);
+        m_labels[pos] = label;
+        m_targets[pos] = child;
+        ++n.edgeCount;
+
+        return child;
+    }
+
+    // returns the node reached by s, or root if s leaves the trie (s must not be empty)
+    NodeIndex walk(const std::string& s) const {
+        NodeIndex node = root;
+        for (char c : s) {
+            node = getChild(node, c);
+            if (node == root) return root;
+        }
+        return node;
+    }
+
+public:
+    CompactTrie() {
+        m_nodes.emplace_back();
+    }
+
+    // Builds the trie from a word list in one pass, sorting it first if it isn't sorted yet.
+    // Consecutive words sharing a prefix share the path, so every node is visited once.
+    explicit CompactTrie(std::vector<std::string> words) {
+        if (!std::is_sorted(words.begin(), words.end())) {
+            std::sort(words.begin(), words.end());
+        }
+
+        m_nodes.emplace_back();
+
+        struct Range {
+            NodeIndex node;
+            std::size_t low, high; // words[low, high) all start with the prefix of node
+            std::size_t depth;     // length of that prefix
+        };
+
+        // BFS, so the runs end up in the same order as the nodes
+        std::queue<Range> q;
+        q.push({root, 0, words.size(), 0});
+        while (!q.empty()) {
+            Range r = q.front();
+            q.pop();
+
+            // the words ending here sort before all the longer ones
+            std::size_t i = r.low;
+            while (i < r.high && words[i].size() == r.depth) {
+                m_nodes[r.node].isWord = r.depth > 0;
+                ++i;
+            }
+
+            std::uint32_t firstEdge = static_cast<std::uint32_t>(m_labels.size());
+            while (i < r.high) {
+                char c = words[i][r.depth];
+                std::size_t j = i + 1;
+                while (j < r.high && words[j][r.depth] == c) ++j;
+
+                NodeIndex child = static_cast<NodeIndex>(m_nodes.size());
+                m_nodes.emplace_back();
+                m_labels.push_back(static_cast<unsigned char>(c));
+                m_targets.push_back(child);
+                q.push({child, i, j, r.depth + 1});
+                i = j;
+            }
+
+            Node& n = m_nodes[r.node];
+            n.firstEdge = firstEdge;
+            n.edgeCount = n.edgeCapacity = static_cast<std::uint16_t>(m_labels.size() - firstEdge);
+        }
+    }
+
+    void insert(const std::string& word) {
+        if (word.empty()) return;
+        NodeIndex curr = root;
+        for (char c : word) {
+            NodeIndex next = getChild(curr, c);
+            if (next == root) {
+                next = addChild(curr, c);
+            }
+            curr = next;
+        }
+        m_nodes[curr].isWord = true;
+
+        if (m_wastedEdges > 1024 && m_wastedEdges * 2 > m_labels.size()) {
+            shrinkToFit();
+        }
+    }
+
+    bool search(const std::string& word) const {
+        if (word.empty()) return false;
+        NodeIndex node = walk(word);
+        return node != root && m_nodes[node].isWord;
+    }
+
+    bool startsWith(const std::string& prefix) const {
+        if (prefix.empty()) return false;
+        return walk(prefix) != root;
+    }
+
+    // Lays the runs out again in node order with no spare capacity, dropping the slots of relocated runs.
+    void shrinkToFit() {
+        std::vector<unsigned char> labels;
+        std::vector<NodeIndex> targets;
+        labels.reserve(m_labels.size() - m_wastedEdges);
+        targets.reserve(m_targets.size() - m_wastedEdges);
+
+        for (Node& n : m_nodes) {
+            std::uint32_t firstEdge = static_cast<std::uint32_t>(labels.size());
+            labels.insert(labels.end(), m_labels.begin() + n.firstEdge, m_labels.begin() + n.firstEdge + n.edgeCount);
+            targets.insert(targets.end(), m_targets.begin() + n.firstEdge, m_targets.begin() + n.firstEdge + n.edgeCount);
+            n.firstEdge = firstEdge;
+            n.edgeCapacity = n.edgeCount;
+        }
+
+        m_labels.swap(labels);
+        m_targets.swap(targets);
+        m_wastedEdges = 0;
+    }
+
+    std::size_t getNodeCount() const noexcept { return m_nodes.size(); }
+
+    // bytes held by the node and edge arrays
+    std::size_t getMemoryUsage() const noexcept {
+        return m_nodes.capacity() * sizeof(Node) + m_labels.capacity() * sizeof(unsigned char) +
+               m_targets.capacity() * sizeof(NodeIndex);
+    }
+};
+
+// Radix (path compressed) trie: chains of single-child nodes collapse into one node whose incoming edge
+// carries the whole label, so keys with long shared prefixes and long unique tails need few nodes and
+// a lookup compares labels with memcmp instead of doing one hash lookup per character.
+// Children are keyed by the first character of their label. Nodes are pooled the same way as in Trie.
+class RadixTrie {
+private:
+    using NodeIndex = std::uint32_t;
+
+    struct Node {
+        std::string m_label; // label of the edge from the parent, empty only for the root
+        std::unordered_map<char, NodeIndex> m_map;
+        bool isWord {false};
+    };
+
+    static constexpr NodeIndex root {0};
+    static constexpr NodeIndex noNode {UINT32_MAX};
+
+    std::vector<Node> m_nodes;
+    std::vector<NodeIndex> m_freeNodes;
+
+    NodeIndex newNode(std::string_view label) {
+        NodeIndex index;
+        if (!m_freeNodes.empty()) {
+            index = m_freeNodes.back();
+            m_freeNodes.pop_back();
+        } else {
+            index = static_cast<NodeIndex>(m_nodes.size());
+            m_nodes.emplace_back();
+        }
+        m_nodes[index].m_label = label;
+        return index;
+    }
+
+    void releaseNode(NodeIndex index) {
+        m_nodes[index].m_label.clear();
+        m_nodes[index].m_map.clear();
+        m_nodes[index].isWord = false;
+        m_freeNodes.push_back(index);
+    }
+
+    NodeIndex getChild(NodeIndex node, char c) const {
+        auto it = m_nodes[node].m_map.find(c);
+        return it == m_nodes[node].m_map.end() ? noNode : it->second;
+    }
+
+    // length of the common prefix of a and b
+    static std::size_t commonPrefix(std::string_view a, std::string_view b) {
+        std::size_t n = std::min(a.size(), b.size());
+        return std::mismatch(a.begin(), a.begin() + n, b.begin()).first - a.begin();
+    }
+
+    // Restores the invariant for the child of node on c after a removal below it:
+    // a child with no word and no children is dropped, one with no word and a single child absorbs it.
+    void compressChild(NodeIndex node, char c) {
+        NodeIndex child = getChild(node, c);
+        Node& n = m_nodes[child];
+        if (n.isWord || n.m_map.size() > 1) return;
+
+        if (n.m_map.empty()) {
+            m_nodes[node].m_map.erase(c);
+            releaseNode(child);
+            return;
+        }
+
+        NodeIndex grandChild = n.m_map.begin()->second;
+        Node& g = m_nodes[grandChild];
+        n.m_label += g.m_label;
+        n.m_map.swap(g.m_map);
+        n.isWord = g.isWord;
+        releaseNode(grandChild);
+    }
+
+    // returns true if the word was removed
+    bool removeWordHelper(NodeIndex node, std::string_view word) {
+        if (word.empty()) {
+            if (!m_nodes[node].isWord) return false;
+            m_nodes[node].isWord = false;
+            return true;
+        }
+
+        NodeIndex child = getChild(node, word[0]);
+        if (child == noNode) return false;
+
+        const std::string& label = m_nodes[child].m_label;
+        if (word.size() < label.size() || std::memcmp(word.data(), label.data(), label.size()) != 0) return false;
+
+        bool removed = removeWordHelper(child, word.substr(label.size()));
+        if (removed) compressChild(node, word[0]);
+        return removed;
+    }
+
+public:
+    RadixTrie() {
+        m_nodes.emplace_back();
+    }
+
+    void insert(const std::string& word) {
+        if (word.empty()) return;
+        NodeIndex node = root;
+        std::string_view rest = word;
+
+        while (!rest.empty()) {
+            NodeIndex child = getChild(node, rest[0]);
+            if (child == noNode) {
+                // the rest of the word becomes a single new leaf
+                NodeIndex leaf = newNode(rest);
+                m_nodes[leaf].isWord = true;
+                m_nodes[node].m_map[rest[0]] = leaf;
+                return;
+            }
+
+            std::size_t common = commonPrefix(m_nodes[child].m_label, rest);
+            if (common < m_nodes[child].m_label.size()) {
+                // split the edge, the new middle node takes the common part of the label
+                NodeIndex middle = newNode(rest.substr(0, common));
+                Node& c = m_nodes[child];
+                m_nodes[middle].m_map[c.m_label[common]] = child;
+                c.m_label.erase(0, common);
+                m_nodes[node].m_map[rest[0]] = middle;
+                child = middle;
+            }
+
+            node = child;
+            rest.remove_prefix(common);
+        }
+
+        m_nodes[node].isWord = true;
+    }
+
+    bool search(const std::string& word) const {
+        if (word.empty()) return false;
+        NodeIndex node = root;
+        std::string_view rest = word;
+
+        while (!rest.empty()) {
+            node = getChild(node, rest[0]);
+            if (node == noNode) return false;
+
+            const std::string& label = m_nodes[node].m_label;
+            if (rest.size() < label.size() || std::memcmp(rest.data(), label.data(), label.size()) != 0) return false;
+            rest.remove_prefix(label.size());
         }
 
-        Node* tmp = node->m_map[word[i]];
-        if (!tmp) return false;
+        return m_nodes[node].isWord;
+    }
+
+    bool startsWith(const std::string& prefix) const {
+        if (prefix.empty()) return false;
+        NodeIndex node = root;
+        std::string_view rest = prefix;
+
+        while (!rest.empty()) {
+            node = getChild(node, rest[0]);
+            if (node == noNode) return false;
+
+            // the prefix may end in the middle of a label
+            const std::string& label = m_nodes[node].m_label;
+            std::size_t n = std::min(rest.size(), label.size());
+            if (std::memcmp(rest.data(), label.data(), n) != 0) return false;
+            rest.remove_prefix(n);
+        }
 
-        bool shouldDeleteCurrNode = removeWordHelper(tmp, word, i + 1);
-        if (shouldDeleteCurrNode) {
-            node->m_map.erase(word[i]);
-            if (node->m_map.empty()) {
-                delete node; node = nullptr;
-                return true;
+        return true;
+    }
+
+    void removeWord(const std::string& word) {
+        if (word.empty()) return;
+        removeWordHelper(root, word);
+    }
+
+    // number of live nodes, the root included
+    std::size_t getNodeCount() const noexcept { return m_nodes.size() - m_freeNodes.size(); }
+
+    void print() const {
+        std::queue<NodeIndex> q;
+        q.push(root);
+        while (!q.empty()) {
+            int size = q.size();
+            while (size--) {
+                const Node& node = m_nodes[q.front()];
+                q.pop();
+                std::string word = (node.isWord) ? "T" : "F";
+                std::cout << "Node(" << node.m_label << ", " << word << ") ";
+                for (const auto& p : node.m_map) {
+                    q.push(p.second);
+                }
             }
-            return false;
+            std::cout << std::endl;
+        }
+    }
+};
+
+// Trie for read-mostly sharing between threads. search() and startsWith() never block: the nodes
+// reachable from the published root are immutable, and a write copies the path it changes and
+// publishes the new root with one atomic store (a batch publishes once for all of its words).
+// Writers are serialized by a mutex. Replaced nodes are freed by epoch based reclamation: a reader pins
+// the global epoch in its own slot while it walks, and a retired path is freed only once every pinned
+// reader started after it was unlinked.
+// Readers that do many lookups should hold a Reader, which keeps its slot instead of claiming one per call.
+// The slots come in blocks of 128, a reader that finds them all taken links a new block, so any number of
+// threads can read at once. Blocks are kept until the trie is destroyed.
+class ConcurrentTrie {
+private:
+    struct Node {
+        std::vector<std::pair<char, Node*>> m_children; // sorted by char
+        bool isWord {false};
+        std::uint64_t m_version {0}; // batch that created the node, it can be changed in place only by that batch
+    };
+
+    struct alignas(64) Slot {
+        std::atomic<bool> m_inUse {false};
+        std::atomic<std::uint64_t> m_epoch {0}; // 0 while not reading
+    };
+
+    static constexpr std::size_t slotsPerBlock {128};
+
+    struct SlotBlock {
+        Slot m_slots[slotsPerBlock];
+        std::atomic<SlotBlock*> m_next {nullptr}; // seq_cst, see claimSlot
+    };
+
+    std::atomic<Node*> m_root;
+    std::atomic<std::uint64_t> m_epoch {1};
+    mutable SlotBlock m_slotBlocks;
+
+    // writer state, guarded by m_writeLock
+    std::mutex m_writeLock;
+    std::uint64_t m_batch {0};
+    Node* m_pendingRoot {nullptr};
+    std::vector<Node*> m_unlinked;                                  // nodes replaced by the current batch
+    std::vector<std::pair<std::uint64_t, std::vector<Node*>>> m_retired; // (epoch they were unlinked in, nodes)
+
+    static const Node* findChild(const Node* node, char c) {
+        auto it = std::lower_bound(node->m_children.begin(), node->m_children.end(), c,
+                                   [](const auto& p, char ch) { return p.first < ch; });
+        return (it != node->m_children.end() && it->first == c) ? it->second : nullptr;
+    }
+
+    static const Node* walk(const Node* node, const std::string& word) {
+        for (char c : word) {
+            node = findChild(node, c);
+            if (!node) return nullptr;
         }
-        return false;
+        return node;
+    }
+
+    static void freeTree(Node* node) {
+        for (auto& p : node->m_children) freeTree(p.second);
+        delete node;
+    }
+
+    static bool tryClaim(Slot& slot) {
+        bool expected = false;
+        return !slot.m_inUse.load(std::memory_order_relaxed) &&
+               slot.m_inUse.compare_exchange_strong(expected, true, std::memory_order_acquire);
+    }
+
+    // A block is linked with a seq_cst CAS and found with seq_cst loads: a reclaim that doesn't see the block
+    // comes before the pin of any reader in it, and such a reader walks the root published before the reclaim.
+    Slot* claimSlot() const {
+        std::size_t start = std::hash<std::thread::id>{}(std::this_thread::get_id()) % slotsPerBlock;
+        SlotBlock* block = &m_slotBlocks;
+        while (true) {
+            for (std::size_t i = 0; i < slotsPerBlock; ++i) {
+                Slot& slot = block->m_slots[(start + i) % slotsPerBlock];
+                if (tryClaim(slot)) return &slot;
+            }
+
+            SlotBlock* next = block->m_next.load(std::memory_order_seq_cst);
+            if (!next) {
+                // every slot is taken, a new block is linked, or the one another reader linked meanwhile is used
+                SlotBlock* fresh = new SlotBlock;
+                fresh->m_slots[0].m_inUse.store(true, std::memory_order_relaxed);
+                if (block->m_next.compare_exchange_strong(next, fresh, std::memory_order_seq_cst)) {
+                    return &fresh->m_slots[0];
+                }
+                delete fresh;
+            }
+            block = next;
+        }
+    }
+
+    // Pins the current epoch in slot and returns the root to read from.
+    // The seq_cst stores order the pin before the root load, so a writer that doesn't see the pin
+    // has already published the new root and this reader will walk that one.
+    const Node* pin(Slot* slot) const {
+        slot->m_epoch.store(m_epoch.load(std::memory_order_seq_cst), std::memory_order_seq_cst);
+        return m_root.load(std::memory_order_seq_cst);
+    }
+
+    static void unpin(Slot* slot) {
+        slot->m_epoch.store(0, std::memory_order_release);
+    }
+
+    // returns a copy of node owned by the current batch, node itself if the batch already owns it
+    Node* ownNode(Node* node) {
+        if (node->m_version == m_batch) return node;
+        Node* copy = new Node(*node);
+        copy->m_version = m_batch;
+        m_unlinked.push_back(node);
+        return copy;
+    }
+
+    Node* ownChild(Node* parent, std::size_t pos) {
+        Node* child = ownNode(parent->m_children[pos].second);
+        parent->m_children[pos].second = child;
+        return child;
+    }
+
+    std::size_t childPosition(const Node* node, char c) const {
+        auto it = std::lower_bound(node->m_children.begin(), node->m_children.end(), c,
+                                   [](const auto& p, char ch) { return p.first < ch; });
+        return it - node->m_children.begin();
+    }
+
+    void insertPending(const std::string& word) {
+        const Node* existing = walk(m_pendingRoot, word);
+        if (word.empty() || (existing && existing->isWord)) return;
+
+        m_pendingRoot = ownNode(m_pendingRoot);
+        Node* node = m_pendingRoot;
+        for (char c : word) {
+            std::size_t pos = childPosition(node, c);
+            if (pos == node->m_children.size() || node->m_children[pos].first != c) {
+                Node* child = new Node;
+                child->m_version = m_batch;
+                node->m_children.insert(node->m_children.begin() + pos, {c, child});
+                node = child;
+            } else {
+                node = ownChild(node, pos);
+            }
+        }
+        node->isWord = true;
+    }
+
+    void removePending(const std::string& word) {
+        const Node* existing = walk(m_pendingRoot, word);
+        if (word.empty() || !existing || !existing->isWord) return;
+
+        m_pendingRoot = ownNode(m_pendingRoot);
+        std::vector<Node*> path {m_pendingRoot};
+        for (char c : word) {
+            path.push_back(ownChild(path.back(), childPosition(path.back(), c)));
+        }
+        path.back()->isWord = false;
+
+        // drop the nodes that no longer lead to a word, they were copied by this batch and never published
+        for (std::size_t i = word.size(); i > 0; --i) {
+            Node* node = path[i];
+            if (node->isWord || !node->m_children.empty()) break;
+            Node* parent = path[i - 1];
+            parent->m_children.erase(parent->m_children.begin() + childPosition(parent, word[i - 1]));
+            delete node;
+        }
+    }
+
+    // frees the retired nodes that no pinned reader can still reach
+    void reclaim() {
+        std::uint64_t oldest = UINT64_MAX;
+        for (const SlotBlock* block = &m_slotBlocks; block; block = block->m_next.load(std::memory_order_seq_cst)) {
+            for (const Slot& slot : block->m_slots) {
+                std::uint64_t epoch = slot.m_epoch.load(std::memory_order_seq_cst);
+                if (epoch != 0) oldest = std::min(oldest, epoch);
+            }
+        }
+        auto it = m_retired.begin();
+        for (; it != m_retired.end() && it->first < oldest; ++it) {
+            for (Node* node : it->second) delete node;
+        }
+        m_retired.erase(m_retired.begin(), it);
+    }
+
+    template<typename Apply>
+    void write(Apply&& apply) {
+        std::lock_guard<std::mutex> lock(m_writeLock);
+        ++m_batch;
+        m_pendingRoot = m_root.load(std::memory_order_relaxed);
+        apply();
+
+        if (m_pendingRoot != m_root.load(std::memory_order_relaxed)) {
+            m_root.store(m_pendingRoot, std::memory_order_seq_cst);
+            // readers pinned at this epoch or earlier may still hold the old path
+            std::uint64_t epoch = m_epoch.fetch_add(1, std::memory_order_seq_cst);
+            m_retired.emplace_back(epoch, std::move(m_unlinked));
+            m_unlinked.clear();
+        }
+        reclaim();
+    }
+
+public:
+    // Read handle owning a reader slot. Not to be shared between threads, but any number of threads
+    // can each hold one.
+    class Reader {
+    public:
+        explicit Reader(const ConcurrentTrie& trie) : m_trie {&trie}, m_slot {trie.claimSlot()} { }
+
+        Reader(Reader&& other) noexcept : m_trie {other.m_trie}, m_slot {other.m_slot} {
+            other.m_slot = nullptr;
+        }
+
+        Reader(const Reader&) = delete;
+        Reader& operator=(const Reader&) = delete;
+        Reader& operator=(Reader&&) = delete;
+
+        ~Reader() {
+            if (m_slot) m_slot->m_inUse.store(false, std::memory_order_release);
+        }
+
+        bool search(const std::string& word) const {
+            const Node* node = walk(m_trie->pin(m_slot), word);
+            bool found = !word.empty() && node && node->isWord;
+            unpin(m_slot);
+            return found;
+        }
+
+        bool startsWith(const std::string& prefix) const {
+            bool found = !prefix.empty() && walk(m_trie->pin(m_slot), prefix);
+            unpin(m_slot);
+            return found;
+        }
+
+    private:
+        const ConcurrentTrie* m_trie;
+        Slot* m_slot;
+    };
+
+    ConcurrentTrie() : m_root {new Node} { }
+
+    ConcurrentTrie(const ConcurrentTrie&) = delete;
+    ConcurrentTrie& operator=(const ConcurrentTrie&) = delete;
+
+    // no reader or writer may be active any more
+    ~ConcurrentTrie() {
+        freeTree(m_root.load(std::memory_order_relaxed));
+        for (auto& retired : m_retired) {
+            for (Node* node : retired.second) delete node;
+        }
+        SlotBlock* block = m_slotBlocks.m_next.load(std::memory_order_relaxed);
+        while (block) {
+            SlotBlock* next = block->m_next.load(std::memory_order_relaxed);
+            delete block;
+            block = next;
+        }
+    }
+
+    Reader reader() const { return Reader(*this); }
+
+    bool search(const std::string& word) const { return reader().search(word); }
+
+    bool startsWith(const std::string& prefix) const { return reader().startsWith(prefix); }
+
+    void insert(const std::string& word) {
+        write([&] { insertPending(word); });
+    }
+
+    void removeWord(const std::string& word) {
+        write([&] { removePending(word); });
+    }
+
+    // applies all inserts, then all removals, and makes them visible at once
+    // nodes created by the batch are changed in place, so each path is copied at most once per batch
+    void applyBatch(const std::vector<std::string>& inserts, const std::vector<std::string>& removals = {}) {
+        write([&] {
+            for (const std::string& word : inserts) insertPending(word);
+            for (const std::string& word : removals) removePending(word);
+        });
     }
 };
@@ -3,6 +3,18 @@
 #include <iostream>
 #include <vector>
 #include <numeric>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <algorithm>
+#include <cstdint>
+#include <span>
+#include <utility>
+#include <map>
+#include <limits>
+#include <stdexcept>
+
+#include "Stats.h"
 
 class UnionFind {
 public:
@@ -20,11 +32,14 @@ public:
         while (root != m_ids[root]) root = m_ids[root];
 
         // compress the path leading back to the root.
+        std::uint64_t steps{ 0 };
         while (p != root) {
             std::size_t next = m_ids[p];
             m_ids[p] = root;
             p = next;
+            ++steps;
         }
+        myDS::stats::count(myDS::stats::pathCompressionSteps, steps);
 
         return root;
     }
@@ -54,8 +69,8 @@ public:
 
     void unify(std::size_t p, std::size_t q) noexcept
     {
-        int root1 = find(p);
-        int root2 = find(q);
+        std::size_t root1 = find(p);
+        std::size_t root2 = find(q);
 
         if (root1 == root2) return;
 
@@ -73,7 +88,7 @@ public:
 
     void display()
     {
-        for (int i{}; i < m_size; ++i) {
+        for (std::size_t i{}; i < m_size; ++i) {
             std::cout << "Index: " << i << ", id: " << m_ids[i] << ", size = " << m_sizes[i] << std::endl;
         }
     }
@@ -84,3 +99,401 @@ private:
     std::vector<std::size_t> m_sizes; // size of each component
     std::size_t m_components; // components' count
 };
+
+// UnionFind that can be shared by threads: unify, find and areConnected may all run concurrently.
+// Parents are atomics and roots are linked with a CAS, always the root with the larger index under
+// the one with the smaller index, so links can never form a cycle. find shortens paths by halving,
+// a lost halving CAS only means the path stays a bit longer.
+// Component sizes aren't tracked, componentLabels() gives the full partition once the threads are done.
+class ConcurrentUnionFind {
+public:
+    ConcurrentUnionFind(std::size_t size) : m_size{ size }, m_parents{ new std::atomic<std::size_t>[size] }, m_components{ size }
+    {
+        for (std::size_t i{}; i < size; ++i) m_parents[i].store(i, std::memory_order_relaxed);
+    }
+
+    // find the root of p's component, the root may change under concurrent unify calls
+    std::size_t find(std::size_t p) const noexcept
+    {
+        while (true) {
+            std::size_t parent{ m_parents[p].load(std::memory_order_acquire) };
+            if (parent == p) return p;
+
+            std::size_t grandParent{ m_parents[parent].load(std::memory_order_acquire) };
+            if (parent != grandParent) {
+                // path halving: point p at its grandparent and continue from there
+                if (m_parents[p].compare_exchange_weak(parent, grandParent, std::memory_order_release, std::memory_order_relaxed)) {
+                    myDS::stats::count(myDS::stats::pathCompressionSteps);
+                }
+            }
+            p = grandParent;
+        }
+    }
+
+    bool areConnected(std::size_t p, std::size_t q) const noexcept
+    {
+        while (true) {
+            p = find(p);
+            q = find(q);
+            if (p == q) return true;
+            // p is still a root after q's root was found, so they were in different components at that point
+            if (m_parents[p].load(std::memory_order_acquire) == p) return false;
+        }
+    }
+
+    // returns true if p and q were in different components
+    bool unify(std::size_t p, std::size_t q) noexcept
+    {
+        while (true) {
+            p = find(p);
+            q = find(q);
+            if (p == q) return false;
+
+            if (p < q) std::swap(p, q);
+            std::size_t expected{ p };
+            if (m_parents[p].compare_exchange_strong(expected, q, std::memory_order_acq_rel, std::memory_order_relaxed)) {
+                m_components.fetch_sub(1, std::memory_order_relaxed);
+                return true;
+            }
+            // p got linked by another thread meanwhile, retry from the new roots
+        }
+    }
+
+    // unify every edge, the edges are split into contiguous chunks over numThreads threads (0 means hardware_concurrency)
+    void unifyBatch(std::span<const std::pair<std::size_t, std::size_t>> edges, unsigned numThreads = 0) noexcept
+    {
+        if (numThreads == 0) numThreads = std::max(1u, std::thread::hardware_concurrency());
+
+        auto work = [&](std::size_t first, std::size_t last) {
+            for (std::size_t i{ first }; i < last; ++i) unify(edges[i].first, edges[i].second);
+        };
+
+        runChunks(edges.size(), std::min<std::size_t>(numThreads, edges.size() / 4096 + 1), work);
+    }
+
+    // labels[i] is the root of i's component, computed by numThreads threads (0 means hardware_concurrency)
+    // call it after the unify calls are done, otherwise labels can be stale
+    std::vector<std::size_t> componentLabels(unsigned numThreads = 0) const
+    {
+        if (numThreads == 0) numThreads = std::max(1u, std::thread::hardware_concurrency());
+        std::vector<std::size_t> labels(m_size);
+
+        auto work = [&](std::size_t first, std::size_t last) {
+            for (std::size_t i{ first }; i < last; ++i) labels[i] = find(i);
+        };
+
+        runChunks(m_size, std::min<std::size_t>(numThreads, m_size / 4096 + 1), work);
+
+        return labels;
+    }
+
+    constexpr std::size_t getSize() const noexcept { return m_size; }
+
+    std::size_t getNumComponents() const noexcept { return m_components.load(std::memory_order_relaxed); }
+
+private:
+    // calls work(first, last) for threads contiguous chunks of [0, count), chunk 0 on the calling thread;
+    // the chunks of threads that can't be started, or whose std::thread can't be allocated, run here too
+    template <typename Work>
+    static void runChunks(std::size_t count, std::size_t threads, const Work& work) noexcept
+    {
+        std::size_t chunk{ (count + threads - 1) / threads };
+        auto runChunk = [&](std::size_t t) { work(std::min(t * chunk, count), std::min((t + 1) * chunk, count)); };
+
+        std::vector<std::thread> workers;
+        std::size_t started{ 1 };
+        try {
+            workers.reserve(threads - 1);
+            for (; started < threads; ++started) {
+                workers.emplace_back(runChunk, started);
+            }
+        }
+        catch (const std::exception&) {
+            // std::system_error or std::bad_alloc, the chunks from started on are left to this thread
+        }
+
+        for (std::size_t t{ started }; t < threads; ++t) runChunk(t);
+        runChunk(0);
+        for (auto& worker : workers) worker.join();
+    }
+
+    const std::size_t m_size; // number of all elements
+    std::unique_ptr<std::atomic<std::size_t>[]> m_parents; // parent of each element, roots point at themselves
+    std::atomic<std::size_t> m_components; // components' count
+};
+
+// UnionFind in 4 bytes per element for up to 2^31 - 1 elements: a single array where m_parents[i] is
+// the parent of i, or minus the component size if i is a root.
+class CompactUnionFind {
+public:
+    // throws std::length_error for more elements than an int32 parent can address
+    CompactUnionFind(std::uint32_t size) : m_parents(checkedSize(size), -1), m_components{ size } { }
+
+    // find to which component p node belongs to
+    std::uint32_t find(std::uint32_t p) const noexcept
+    {
+        std::uint32_t root{ p };
+        while (m_parents[root] >= 0) root = m_parents[root];
+
+        // compress the path leading back to the root.
+        std::uint64_t steps{ 0 };
+        while (p != root) {
+            std::uint32_t next = m_parents[p];
+            m_parents[p] = root;
+            p = next;
+            ++steps;
+        }
+        myDS::stats::count(myDS::stats::pathCompressionSteps, steps);
+
+        return root;
+    }
+
+    bool areConnected(std::uint32_t p, std::uint32_t q) const noexcept
+    {
+        return find(p) == find(q);
+    }
+
+    std::uint32_t getComponentSize(std::uint32_t p) const noexcept
+    {
+        return -m_parents[find(p)];
+    }
+
+    std::uint32_t getSize() const noexcept { return m_parents.size(); }
+
+    std::uint32_t getNumComponents() const noexcept { return m_components; }
+
+    void unify(std::uint32_t p, std::uint32_t q) noexcept
+    {
+        std::uint32_t root1 = find(p);
+        std::uint32_t root2 = find(q);
+
+        if (root1 == root2) return;
+
+        // sizes are stored negated, the more negative root is the larger component
+        if (m_parents[root1] > m_parents[root2]) std::swap(root1, root2);
+        m_parents[root1] += m_parents[root2];
+        m_parents[root2] = root1;
+
+        --m_components;
+    }
+
+    // unify every edge after sorting the edges in place by their smaller endpoint, so consecutive
+    // unify calls touch nearby parts of m_parents instead of jumping around the array
+    void unifyBatch(std::span<std::pair<std::uint32_t, std::uint32_t>> edges) noexcept
+    {
+        auto key = [](const std::pair<std::uint32_t, std::uint32_t>& e) {
+            return std::minmax(e.first, e.second);
+        };
+        std::sort(edges.begin(), edges.end(), [&](const auto& a, const auto& b) { return key(a) < key(b); });
+
+        for (const auto& [p, q] : edges) unify(p, q);
+    }
+
+private:
+    static std::size_t checkedSize(std::uint32_t size)
+    {
+        if (size > static_cast<std::uint32_t>(std::numeric_limits<std::int32_t>::max())) {
+            throw std::length_error{ "CompactUnionFind: more than 2^31 - 1 elements" };
+        }
+        return size;
+    }
+
+    mutable std::vector<std::int32_t> m_parents; // parent of each element, -size for roots
+    std::uint32_t m_components; // components' count
+};
+
+// UnionFind that can undo unify calls. It uses union by size without path compression, so every
+// find is O(log n) and a unify changes exactly one id and one size, which are recorded in a change
+// log. checkpoint() marks the current state and rollback() undoes everything after a mark in O(1)
+// per unify.
+class RollbackUnionFind {
+public:
+    RollbackUnionFind(std::size_t size) : m_size{ size }, m_components{ size }
+    {
+        m_ids.resize(size);
+        m_sizes.resize(size, 1);
+        std::iota(m_ids.begin(), m_ids.end(), 0);
+    }
+
+    // find to which component p node belongs to, paths are left as they are
+    std::size_t find(std::size_t p) const noexcept
+    {
+        while (p != m_ids[p]) p = m_ids[p];
+        return p;
+    }
+
+    bool areConnected(std::size_t p, std::size_t q) const noexcept
+    {
+        return find(p) == find(q);
+    }
+
+    std::size_t getComponentSize(std::size_t p) const noexcept
+    {
+        return m_sizes[find(p)];
+    }
+
+    constexpr std::size_t getSize() const noexcept { return m_size; }
+
+    constexpr std::size_t getNumComponents() const noexcept { return m_components; }
+
+    // returns true if p and q were in different components
+    bool unify(std::size_t p, std::size_t q)
+    {
+        std::size_t root1 = find(p);
+        std::size_t root2 = find(q);
+
+        if (root1 == root2) return false;
+
+        if (m_sizes[root1] < m_sizes[root2]) std::swap(root1, root2);
+        m_sizes[root1] += m_sizes[root2];
+        m_ids[root2] = root1;
+        m_history.push_back(root2);
+
+        --m_components;
+        return true;
+    }
+
+    // returns a mark to roll back to
+    std::size_t checkpoint() const noexcept { return m_history.size(); }
+
+    // undo every unify made after checkpoint mark was taken
+    void rollback(std::size_t mark) noexcept
+    {
+        while (m_history.size() > mark) {
+            std::size_t root2 = m_history.back();
+            m_history.pop_back();
+
+            std::size_t root1 = m_ids[root2];
+            m_sizes[root1] -= m_sizes[root2];
+            m_ids[root2] = root2;
+            ++m_components;
+        }
+    }
+
+private:
+    const std::size_t m_size; // number of all elements
+    std::vector<std::size_t> m_ids; // id[i] is the index of parent of i, if id[i] == i => i is a root
+    std::vector<std::size_t> m_sizes; // size of each component, only valid for roots
+    std::size_t m_components; // components' count
+    std::vector<std::size_t> m_history; // roots that were attached by unify, in order
+};
+
+// Offline dynamic connectivity: record a sequence of edge additions, edge removals and queries,
+// then solve() answers all the queries in O((n + q) log q log n) with one RollbackUnionFind instead of
+// rebuilding for every query. Every edge is alive for an interval of the query timeline; the
+// interval is stored in the O(log q) nodes of a segment tree over the timeline that cover it, and a
+// depth-first walk unifies the edges of a node on the way down and rolls them back on the way up,
+// so at each leaf exactly the edges alive at that query time are unified.
+class OfflineDynamicConnectivity {
+public:
+    OfflineDynamicConnectivity(std::size_t size) : m_size{ size } { }
+
+    // the same edge may be added several times, each addition needs its own removal
+    void addEdge(std::size_t p, std::size_t q)
+    {
+        m_open[key(p, q)].push_back(m_queries.size());
+    }
+
+    // removing an edge that isn't there is ignored
+    void removeEdge(std::size_t p, std::size_t q)
+    {
+        auto it = m_open.find(key(p, q));
+        if (it == m_open.end()) return;
+
+        m_intervals.push_back({ it->first, it->second.back(), m_queries.size() });
+        it->second.pop_back();
+        if (it->second.empty()) m_open.erase(it);
+    }
+
+    // asks whether p and q are connected now, the answer is 1 or 0
+    void askConnected(std::size_t p, std::size_t q)
+    {
+        m_queries.push_back({ p, q, true });
+    }
+
+    // asks for the number of components now
+    void askNumComponents()
+    {
+        m_queries.push_back({ 0, 0, false });
+    }
+
+    // returns the answers of the queries in the order they were asked
+    std::vector<std::size_t> solve() const
+    {
+        std::size_t numQueries = m_queries.size();
+        std::vector<std::size_t> answers(numQueries);
+        if (numQueries == 0) return answers;
+
+        // edges still open stay alive until the last query
+        std::vector<Interval> intervals = m_intervals;
+        for (const auto& [edge, starts] : m_open) {
+            for (std::size_t start : starts) intervals.push_back({ edge, start, numQueries });
+        }
+
+        std::vector<std::vector<std::pair<std::size_t, std::size_t>>> tree(4 * numQueries);
+        for (const Interval& interval : intervals) {
+            if (interval.start < interval.end) addInterval(tree, interval, 0, 0, numQueries - 1);
+        }
+
+        RollbackUnionFind uf{ m_size };
+        solve(tree, uf, answers, 0, 0, numQueries - 1);
+        return answers;
+    }
+
+private:
+    struct Interval {
+        std::pair<std::size_t, std::size_t> edge;
+        std::size_t start; // first query the edge is alive for
+        std::size_t end;   // first query after its removal
+    };
+
+    struct Query {
+        std::size_t p;
+        std::size_t q;
+        bool connected; // otherwise the number of components
+    };
+
+    static std::pair<std::size_t, std::size_t> key(std::size_t p, std::size_t q)
+    {
+        return { std::min(p, q), std::max(p, q) };
+    }
+
+    static void addInterval(std::vector<std::vector<std::pair<std::size_t, std::size_t>>>& tree, const Interval& interval,
+                            std::size_t pos, std::size_t low, std::size_t high)
+    {
+        if (interval.end <= low || interval.start > high) return;
+        if (interval.start <= low && high < interval.end) {
+            tree[pos].push_back(interval.edge);
+            return;
+        }
+
+        std::size_t mid{ (high - low) / 2 + low };
+        addInterval(tree, interval, 2 * pos + 1, low, mid);
+        addInterval(tree, interval, 2 * pos + 2, mid + 1, high);
+    }
+
+    void solve(const std::vector<std::vector<std::pair<std::size_t, std::size_t>>>& tree, RollbackUnionFind& uf,
+               std::vector<std::size_t>& answers, std::size_t pos, std::size_t low, std::size_t high) const
+    {
+        std::size_t mark = uf.checkpoint();
+        for (const auto& [p, q] : tree[pos]) uf.unify(p, q);
+
+        if (low == high) {
+            const Query& query = m_queries[low];
+            answers[low] = query.connected ? uf.areConnected(query.p, query.q) : uf.getNumComponents();
+        }
+        else {
+            std::size_t mid{ (high - low) / 2 + low };
+            solve(tree, uf, answers, 2 * pos + 1, low, mid);
+            solve(tree, uf, answers, 2 * pos + 2, mid + 1, high);
+        }
+
+        uf.rollback(mark);
+    }
+
+private:
+    const std::size_t m_size; // number of all elements
+    std::vector<Query> m_queries;
+    std::vector<Interval> m_intervals; // edges that were added and removed again
+    std::map<std::pair<std::size_t, std::size_t>, std::vector<std::size_t>> m_open; // alive edges and the queries they start at
+};
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace myDS {
+
+    /*
+    * Threads kept alive between parallel calls, for batch operations issued over and over (e.g. once per tick),
+    * where starting threads on every call would cost more than the work. parallelFor splits [0, count) into
+    * chunks of at least minChunk items that are handed out under a mutex, so they should be coarse; the
+    * calling thread works on the chunks too. One parallelFor runs at a time, calls from several threads
+    * are serialized.
+    */
+    class WorkerPool {
+    public:
+        // numThreads counts the calling thread, 0 means std::thread::hardware_concurrency()
+        explicit WorkerPool(unsigned numThreads = 0) {
+            if (numThreads == 0) numThreads = std::max(1u, std::thread::hardware_concurrency());
+            m_threads.reserve(numThreads - 1);
+            for (unsigned t = 1; t < numThreads; ++t) m_threads.emplace_back([this] { workerLoop(); });
+        }
+
+        WorkerPool(const WorkerPool&) = delete;
+        WorkerPool& operator=(const WorkerPool&) = delete;
+
+        ~WorkerPool() {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_stop = true;
+            }
+            m_wake.notify_all();
+            for (std::thread& thread : m_threads) thread.join();
+        }
+
+        // threads taking part in a call, the calling one included
+        unsigned size() const noexcept { return static_cast<unsigned>(m_threads.size() + 1); }
+
+        // Calls fn(first, last) for consecutive ranges covering [0, count) and returns once all of them ran.
+        template <typename Fn>
+        void parallelFor(std::size_t count, std::size_t minChunk, Fn&& fn) {
+            minChunk = std::max<std::size_t>(minChunk, 1);
+            std::size_t numChunks = std::min<std::size_t>(size(), (count + minChunk - 1) / minChunk);
+            if (numChunks <= 1) {
+                if (count) fn(std::size_t{0}, count);
+                return;
+            }
+
+            std::lock_guard<std::mutex> call(m_callMutex);
+            std::size_t chunk = (count + numChunks - 1) / numChunks;
+            auto runChunk = [&](std::size_t index) {
+                fn(index * chunk, std::min(count, (index + 1) * chunk));
+            };
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_job = [](void* context, std::size_t index) { (*static_cast<decltype(runChunk)*>(context))(index); };
+                m_context = &runChunk;
+                m_numChunks = numChunks;
+                m_nextChunk = 0;
+                m_pending = numChunks;
+            }
+            m_wake.notify_all();
+
+            std::unique_lock<std::mutex> lock(m_mutex);
+            runChunks(lock);
+            m_done.wait(lock, [this] { return m_pending == 0; });
+        }
+
+    private:
+        // takes chunks until none is left, the lock is held between chunks only
+        void runChunks(std::unique_lock<std::mutex>& lock) {
+            while (m_nextChunk < m_numChunks) {
+                std::size_t index = m_nextChunk++;
+                void (*job)(void*, std::size_t) = m_job;
+                void* context = m_context;
+
+                lock.unlock();
+                job(context, index);
+                lock.lock();
+
+                // the job can't be replaced before this, a new one waits for m_pending to drop to 0
+                if (--m_pending == 0) m_done.notify_one();
+            }
+        }
+
+        void workerLoop() {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            while (true) {
+                m_wake.wait(lock, [this] { return m_stop || m_nextChunk < m_numChunks; });
+                if (m_stop) return;
+                runChunks(lock);
+            }
+        }
+
+    private:
+        std::vector<std::thread> m_threads;
+        std::mutex m_callMutex; // one parallelFor at a time
+
+        // the current job, guarded by m_mutex
+        std::mutex m_mutex;
+        std::condition_variable m_wake;
+        std::condition_variable m_done;
+        void (*m_job)(void*, std::size_t){ nullptr };
+        void* m_context{ nullptr };
+        std::size_t m_numChunks{ 0 };
+        std::size_t m_nextChunk{ 0 };
+        std::size_t m_pending{ 0 }; // chunks not finished yet
+        bool m_stop{ false };
+    };
+
+} // myDS
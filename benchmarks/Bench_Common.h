@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "Stats.h"
+
+namespace bench {
+
+    // Counts the myDS::stats of the timed part of a benchmark, the work done between pause() and resume()
+    // (e.g. building a tree to remove from) is left out, and reports them per iteration.
+    class StatsCounter {
+    public:
+        explicit StatsCounter(benchmark::State& state) : m_state{ state } { myDS::stats::reset(); }
+
+        void pause() {
+            m_state.PauseTiming();
+            m_pausedAt = myDS::stats::snapshot();
+        }
+
+        void resume() {
+            myDS::Stats now{ myDS::stats::snapshot() };
+            m_excluded.rotations += now.rotations - m_pausedAt.rotations;
+            m_excluded.nodeSplits += now.nodeSplits - m_pausedAt.nodeSplits;
+            m_excluded.failureLinkHops += now.failureLinkHops - m_pausedAt.failureLinkHops;
+            m_excluded.pathCompressionSteps += now.pathCompressionSteps - m_pausedAt.pathCompressionSteps;
+            m_state.ResumeTiming();
+        }
+
+        // the counters that moved, the others would only clutter the report
+        ~StatsCounter() {
+            myDS::Stats total{ myDS::stats::snapshot() };
+            report("rotations", total.rotations - m_excluded.rotations);
+            report("nodeSplits", total.nodeSplits - m_excluded.nodeSplits);
+            report("failureLinkHops", total.failureLinkHops - m_excluded.failureLinkHops);
+            report("pathCompressionSteps", total.pathCompressionSteps - m_excluded.pathCompressionSteps);
+        }
+
+    private:
+        void report(const char* name, std::uint64_t count) {
+            if (count) m_state.counters[name] = benchmark::Counter(double(count), benchmark::Counter::kAvgIterations);
+        }
+
+        benchmark::State& m_state;
+        myDS::Stats m_pausedAt;
+        myDS::Stats m_excluded;
+    };
+
+    // n keys spread evenly over [0, 2^31)
+    struct Uniform {
+        static std::vector<int> keys(std::size_t n, std::uint32_t seed) {
+            std::mt19937 rng{ seed };
+            std::uniform_int_distribution<int> dist{ 0, INT32_MAX };
+            std::vector<int> keys(n);
+            for (int& key : keys) key = dist(rng);
+            return keys;
+        }
+    };
+
+    // n keys out of [0, n) where the key of rank r comes up about 1 / r as often as the most frequent one,
+    // the ranks are scattered over the range so that the hot keys aren't neighbours
+    struct Skewed {
+        static std::vector<int> keys(std::size_t n, std::uint32_t seed) {
+            std::mt19937 rng{ seed };
+            std::uniform_real_distribution<double> dist{ 0.0, 1.0 };
+            std::vector<int> keys(n);
+            for (int& key : keys) {
+                auto rank = static_cast<std::uint64_t>(std::pow(double(n), dist(rng))) - 1;
+                key = static_cast<int>(rank * 2654435761u % n);
+            }
+            return keys;
+        }
+    };
+
+} // bench
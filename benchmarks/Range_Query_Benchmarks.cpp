@@ -0,0 +1,75 @@
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "Segment_Tree.h"
+#include "Sparse_Table_h"
+#include "Bench_Common.h"
+
+// state.range(0) values, queried with as many random ranges or updated at as many random positions
+
+static std::vector<int> values(std::size_t n) {
+    return bench::Uniform::keys(n, 1);
+}
+
+static std::vector<std::pair<int, int>> ranges(std::size_t n) {
+    std::mt19937 rng{ 2 };
+    std::uniform_int_distribution<int> dist{ 0, int(n) - 1 };
+    std::vector<std::pair<int, int>> ranges(n);
+    for (auto& [low, high] : ranges) {
+        low = dist(rng);
+        high = dist(rng);
+        if (high < low) std::swap(low, high);
+    }
+    return ranges;
+}
+
+static void BM_SegmentTreeRMQ_Query(benchmark::State& state) {
+    SegmentTreeRMQ tree{ values(state.range(0)) };
+    auto queries{ ranges(state.range(0)) };
+
+    for (auto _ : state) {
+        for (auto [low, high] : queries) benchmark::DoNotOptimize(tree.rangeMinQuery(low, high));
+    }
+    state.SetItemsProcessed(state.iterations() * queries.size());
+}
+
+static void BM_SegmentTreeRMQ_Update(benchmark::State& state) {
+    std::vector<int> data{ values(state.range(0)) };
+    SegmentTreeRMQ tree{ data };
+    auto updates{ ranges(state.range(0)) };
+
+    for (auto _ : state) {
+        for (auto [index, val] : updates) tree.update(index, val);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * updates.size());
+}
+
+static void BM_SparseTableRMQ_Query(benchmark::State& state) {
+    SparseTableRMQ table{ values(state.range(0)) };
+    auto queries{ ranges(state.range(0)) };
+
+    for (auto _ : state) {
+        for (auto [low, high] : queries) benchmark::DoNotOptimize(table.query(low, high));
+    }
+    state.SetItemsProcessed(state.iterations() * queries.size());
+}
+
+// a sparse table has no point update, a change to the values costs a rebuild
+static void BM_SparseTableRMQ_Rebuild(benchmark::State& state) {
+    SparseTableRMQ table{ values(state.range(0)) };
+
+    for (auto _ : state) {
+        table.preprocessRMQ();
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK(BM_SegmentTreeRMQ_Query)->RangeMultiplier(16)->Range(1 << 10, 1 << 20);
+BENCHMARK(BM_SegmentTreeRMQ_Update)->RangeMultiplier(16)->Range(1 << 10, 1 << 20);
+BENCHMARK(BM_SparseTableRMQ_Query)->RangeMultiplier(16)->Range(1 << 10, 1 << 20);
+BENCHMARK(BM_SparseTableRMQ_Rebuild)->RangeMultiplier(16)->Range(1 << 10, 1 << 20);
@@ -0,0 +1,102 @@
+#include <random>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "Trie_Tree.h"
+#include "Aho-Corasick.h"
+#include "Bench_Common.h"
+
+// n lowercase words of 3 to 12 letters
+static std::vector<std::string> randomWords(std::size_t n, std::uint32_t seed) {
+    std::mt19937 rng{ seed };
+    std::uniform_int_distribution<int> length{ 3, 12 };
+    std::uniform_int_distribution<int> letter{ 'a', 'z' };
+    std::vector<std::string> words(n);
+    for (std::string& word : words) {
+        word.resize(length(rng));
+        for (char& c : word) c = char(letter(rng));
+    }
+    return words;
+}
+
+// a DNA like text of 1 MiB with state.range(0) patterns of 8 letters, half of them taken from the text
+static std::string dnaText() {
+    std::mt19937 rng{ 3 };
+    std::uniform_int_distribution<int> base{ 0, 3 };
+    std::string text(1 << 20, 'a');
+    for (char& c : text) c = "acgt"[base(rng)];
+    return text;
+}
+
+static std::vector<std::string> dnaPatterns(const std::string& text, std::size_t n) {
+    std::mt19937 rng{ 4 };
+    std::uniform_int_distribution<std::size_t> offset{ 0, text.size() - 8 };
+    std::uniform_int_distribution<int> base{ 0, 3 };
+    std::vector<std::string> patterns(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        if (i % 2 == 0) {
+            patterns[i] = text.substr(offset(rng), 8);
+        } else {
+            patterns[i].resize(8);
+            for (char& c : patterns[i]) c = "acgt"[base(rng)];
+        }
+    }
+    return patterns;
+}
+
+static void BM_Trie_Build(benchmark::State& state) {
+    auto words{ randomWords(state.range(0), 1) };
+
+    for (auto _ : state) {
+        Trie trie;
+        for (const std::string& word : words) trie.insert(word);
+        benchmark::DoNotOptimize(trie);
+    }
+    state.SetItemsProcessed(state.iterations() * words.size());
+}
+
+static void BM_Trie_Search(benchmark::State& state) {
+    Trie trie;
+    for (const std::string& word : randomWords(state.range(0), 1)) trie.insert(word);
+    // as many misses as hits
+    auto queries{ randomWords(state.range(0) / 2, 1) };
+    auto misses{ randomWords(state.range(0) / 2, 2) };
+    queries.insert(queries.end(), misses.begin(), misses.end());
+
+    for (auto _ : state) {
+        for (const std::string& word : queries) benchmark::DoNotOptimize(trie.search(word));
+    }
+    state.SetItemsProcessed(state.iterations() * queries.size());
+}
+
+static void BM_AhoCorasick_Build(benchmark::State& state) {
+    auto words{ randomWords(state.range(0), 1) };
+    bench::StatsCounter stats{ state };
+
+    for (auto _ : state) {
+        stats.pause();
+        std::vector<std::string> patterns{ words };
+        stats.resume();
+
+        Aho_Corasick automaton{ std::move(patterns) };
+        benchmark::DoNotOptimize(automaton);
+    }
+    state.SetItemsProcessed(state.iterations() * words.size());
+}
+
+static void BM_AhoCorasick_Scan(benchmark::State& state) {
+    std::string text{ dnaText() };
+    Aho_Corasick automaton{ dnaPatterns(text, state.range(0)) };
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(automaton.countPatterns(text));
+    }
+    state.SetBytesProcessed(state.iterations() * text.size());
+}
+
+BENCHMARK(BM_Trie_Build)->RangeMultiplier(8)->Range(1 << 10, 1 << 16);
+BENCHMARK(BM_Trie_Search)->RangeMultiplier(8)->Range(1 << 10, 1 << 16);
+BENCHMARK(BM_AhoCorasick_Build)->RangeMultiplier(8)->Range(1 << 10, 1 << 16);
+BENCHMARK(BM_AhoCorasick_Scan)->RangeMultiplier(8)->Range(1 << 4, 1 << 10);
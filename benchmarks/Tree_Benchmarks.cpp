@@ -0,0 +1,65 @@
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "AVL_Tree.h"
+#include "RB_Tree.h"
+#include "B_Tree.h"
+#include "Bench_Common.h"
+
+// insert, search and remove of state.range(0) keys, the keys of Dist (see Bench_Common.h)
+
+template <typename Tree, typename Dist>
+static void BM_Insert(benchmark::State& state) {
+    std::vector<int> keys{ Dist::keys(state.range(0), 1) };
+    bench::StatsCounter stats{ state };
+
+    for (auto _ : state) {
+        Tree tree;
+        for (int key : keys) tree.insert(key);
+        benchmark::DoNotOptimize(tree);
+    }
+    state.SetItemsProcessed(state.iterations() * keys.size());
+}
+
+template <typename Tree, typename Dist>
+static void BM_Search(benchmark::State& state) {
+    Tree tree;
+    for (int key : Dist::keys(state.range(0), 1)) tree.insert(key);
+    std::vector<int> queries{ Dist::keys(state.range(0), 2) };
+    bench::StatsCounter stats{ state };
+
+    for (auto _ : state) {
+        for (int key : queries) benchmark::DoNotOptimize(tree.search(key));
+    }
+    state.SetItemsProcessed(state.iterations() * queries.size());
+}
+
+template <typename Tree, typename Dist>
+static void BM_Remove(benchmark::State& state) {
+    std::vector<int> keys{ Dist::keys(state.range(0), 1) };
+    bench::StatsCounter stats{ state };
+
+    for (auto _ : state) {
+        stats.pause();
+        Tree tree;
+        for (int key : keys) tree.insert(key);
+        stats.resume();
+
+        for (int key : keys) tree.remove(key);
+        benchmark::DoNotOptimize(tree);
+    }
+    state.SetItemsProcessed(state.iterations() * keys.size());
+}
+
+#define TREE_BENCHMARKS(Tree)                                                               \
+    BENCHMARK_TEMPLATE(BM_Insert, Tree, bench::Uniform)->RangeMultiplier(8)->Range(1 << 10, 1 << 16); \
+    BENCHMARK_TEMPLATE(BM_Insert, Tree, bench::Skewed)->RangeMultiplier(8)->Range(1 << 10, 1 << 16);  \
+    BENCHMARK_TEMPLATE(BM_Search, Tree, bench::Uniform)->RangeMultiplier(8)->Range(1 << 10, 1 << 16); \
+    BENCHMARK_TEMPLATE(BM_Search, Tree, bench::Skewed)->RangeMultiplier(8)->Range(1 << 10, 1 << 16);  \
+    BENCHMARK_TEMPLATE(BM_Remove, Tree, bench::Uniform)->RangeMultiplier(8)->Range(1 << 10, 1 << 16); \
+    BENCHMARK_TEMPLATE(BM_Remove, Tree, bench::Skewed)->RangeMultiplier(8)->Range(1 << 10, 1 << 16)
+
+TREE_BENCHMARKS(myDS::AVL<int>);
+TREE_BENCHMARKS(myDS::RBT<int>);
+TREE_BENCHMARKS(BTree<int>);
@@ -0,0 +1,53 @@
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "UnionFind.h"
+#include "Bench_Common.h"
+
+// a random graph of state.range(0) vertices and twice as many edges
+static std::vector<std::pair<std::size_t, std::size_t>> randomEdges(std::size_t n) {
+    std::mt19937 rng{ 1 };
+    std::uniform_int_distribution<std::size_t> dist{ 0, n - 1 };
+    std::vector<std::pair<std::size_t, std::size_t>> edges(2 * n);
+    for (auto& [p, q] : edges) {
+        p = dist(rng);
+        q = dist(rng);
+    }
+    return edges;
+}
+
+static void BM_UnionFind_Unify(benchmark::State& state) {
+    std::size_t n = state.range(0);
+    auto edges{ randomEdges(n) };
+    bench::StatsCounter stats{ state };
+
+    for (auto _ : state) {
+        UnionFind uf{ n };
+        for (auto [p, q] : edges) uf.unify(p, q);
+        benchmark::DoNotOptimize(uf.getNumComponents());
+    }
+    state.SetItemsProcessed(state.iterations() * edges.size());
+}
+
+// finds on a fresh forest, before path compression has flattened it
+static void BM_UnionFind_Find(benchmark::State& state) {
+    std::size_t n = state.range(0);
+    auto edges{ randomEdges(n) };
+    bench::StatsCounter stats{ state };
+
+    for (auto _ : state) {
+        stats.pause();
+        UnionFind uf{ n };
+        for (auto [p, q] : edges) uf.unify(p, q);
+        stats.resume();
+
+        for (std::size_t p = 0; p < n; ++p) benchmark::DoNotOptimize(uf.find(p));
+    }
+    state.SetItemsProcessed(state.iterations() * n);
+}
+
+BENCHMARK(BM_UnionFind_Unify)->RangeMultiplier(16)->Range(1 << 10, 1 << 20);
+BENCHMARK(BM_UnionFind_Find)->RangeMultiplier(16)->Range(1 << 10, 1 << 20);